@@ -0,0 +1,57 @@
+#include "DistributedCompile.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDebug>
+
+#define DEFAULT_COMPILER "/usr/bin/gcc"
+
+static void usage()
+{
+	qWarning() << "Usage: " COMPILE_DAEMON_PROGRAM " --listen address [--allow subnet]... [--port N] [--slots N] [--compiler path]";
+}
+
+/*
+ * Runs on every lab machine that should take compile jobs. Point KISS at them
+ * with the COMPILE_HOSTS project setting or KISS_COMPILE_HOSTS. There is no
+ * authentication, so the operator picks the address to listen on and should
+ * limit clients to the lab's subnet with --allow (e.g. 10.0.3.0/24).
+ */
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	
+	quint16 port = COMPILE_DAEMON_DEFAULT_PORT;
+	QHostAddress address;
+	QList<QPair<QHostAddress, int> > allowed;
+	quint16 jobSlots = 0;
+	QString compiler = DEFAULT_COMPILER;
+	
+	const QStringList args = QCoreApplication::arguments();
+	for(int i = 1; i < args.size(); ++i) {
+		if(args[i] == "--port" && i + 1 < args.size()) port = args[++i].toUShort();
+		else if(args[i] == "--listen" && i + 1 < args.size()) address = QHostAddress(args[++i]);
+		else if(args[i] == "--allow" && i + 1 < args.size()) {
+			const QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(args[++i]);
+			if(subnet.first.isNull()) {
+				usage();
+				return 1;
+			}
+			allowed << subnet;
+		} else if(args[i] == "--slots" && i + 1 < args.size()) jobSlots = args[++i].toUShort();
+		else if(args[i] == "--compiler" && i + 1 < args.size()) compiler = args[++i];
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if(address.isNull()) {
+		usage();
+		return 1;
+	}
+	
+	CompileDaemon daemon(compiler, jobSlots);
+	daemon.setAllowed(allowed);
+	if(!daemon.listen(address, port)) return 1;
+	return app.exec();
+}
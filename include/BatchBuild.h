@@ -0,0 +1,69 @@
+#ifndef _BATCHBUILD_H_
+#define _BATCHBUILD_H_
+
+#include "Compiler.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+class JobPool;
+
+// Exit codes of "KISS --build"
+#define BATCH_BUILD_SUCCEEDED 0
+#define BATCH_BUILD_FAILED 1
+#define BATCH_BUILD_USAGE 2
+
+/*!
+ * Compiles projects without any UI, for graders and CI ("KISS --build").
+ * Several projects are built at once. Their compilers share one pool of jobs
+ * sized to the machine, and the results of every project are written as JSON.
+ */
+class BatchBuild
+{
+public:
+	BatchBuild();
+	~BatchBuild();
+
+	//! Arguments following --build. Relative project paths are resolved right away.
+	const bool parseArguments(const QStringList& args);
+	static QString usage();
+
+	//! Builds every project and writes the results. \return Exit code
+	int exec();
+
+private:
+	struct Result
+	{
+		Result();
+
+		QString project;
+		QString name;
+		bool success;
+		//! Set when the project couldn't be built at all
+		QString error;
+		qint64 msecs;
+		QStringList outputs;
+		QString trace;
+		CompileResult compileResult;
+	};
+
+	class Task;
+	friend class Task;
+
+	void build(int index, Result* result);
+	QByteArray resultsJson(const QList<Result>& results, qint64 msecs) const;
+	static void messageHandler(QtMsgType type, const char* msg);
+
+	QStringList m_projects;
+	int m_jobs;
+	int m_parallelProjects;
+	qint64 m_timeout;
+	bool m_profile;
+	QString m_resultsPath;
+	JobPool* m_pool;
+
+	static bool s_verbose;
+};
+
+#endif
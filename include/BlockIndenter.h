@@ -0,0 +1,94 @@
+#ifndef _BLOCKINDENTER_H_
+#define _BLOCKINDENTER_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+
+class QsciScintilla;
+
+/*!
+ * Indents C style blocks in an editor, one tab per level of nesting. Braces
+ * only count where the lexer styled them as braces, so those in comments and
+ * strings are ignored. Styles are read from Scintilla in bulk, never a
+ * character at a time.
+ *
+ * The number of blocks open at the start of every line is kept up to date
+ * from the editor's modification notifications. An edit marks the lines it
+ * touched, and the next query rescans from the first of them only until the
+ * depths after the edit match the ones from before it again.
+ */
+class BlockIndenter : public QObject
+{
+Q_OBJECT
+public:
+	BlockIndenter(QsciScintilla* editor, QObject* parent = 0);
+
+	//! Reindents every line as a single undo action. \return Number of lines changed
+	int indentAll();
+
+	/*!
+	 * Reindents one line, leaving the caret after the indentation if it was in it.
+	 * \return true if the line changed
+	 */
+	const bool indentLine(int line);
+
+	//! Tabs line should be indented by
+	int level(int line);
+
+private slots:
+	void modified(int position, int modificationType, const char* text, int length, int linesAdded,
+		int line, int foldLevelNow, int foldLevelPrev, int token, int annotationLinesAdded);
+
+private:
+	struct LineIndent
+	{
+		//! Position of the line's first character
+		int start;
+		//! Position after the line's leading whitespace
+		int indentEnd;
+		int level;
+	};
+
+	struct LineScan
+	{
+		int opened;
+		int closed;
+		int indentEnd;
+		//! Style of the line's last character, its newline if it has one
+		int lastStyle;
+	};
+
+	//! Reads the lexer's block characters and styles. \return false if it has none
+	const bool readLexer();
+	//! Scans [start, end) of a buffer from styledText() that begins at base
+	LineScan scanLine(const QByteArray& styled, int base, int start, int end) const;
+	//! \return The indentation for a scanned line or -1 if it should be left alone
+	int indentFor(const LineScan& scan, int depth, int nextStyle) const;
+	//! Characters and styles of [start, end), interleaved the way Scintilla stores them
+	QByteArray styledText(int start, int end) const;
+	//! Replaces the leading whitespace of the given lines, as one undo action
+	int apply(const QList<LineIndent>& lines);
+
+	//! Makes m_depth[line] current, scanning no further than needed
+	void updateDepth(int line);
+	void invalidate(int first, int last);
+
+	QsciScintilla* m_editor;
+
+	char m_blockStart;
+	char m_blockEnd;
+	int m_blockStartStyle;
+	int m_blockEndStyle;
+	int m_defaultStyle;
+
+	//! Blocks open at the start of each line
+	QVector<int> m_depth;
+	//! First line whose contents may have changed since it was scanned. m_depth is current up to and including it.
+	int m_dirty;
+	//! Last line known to have changed. Depths can only converge after it.
+	int m_dirtyEnd;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef _BUILDPROFILE_H_
+#define _BUILDPROFILE_H_
+
+#include "CommandChain.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QElapsedTimer>
+
+// Project setting. Set to "true" to time every compile and write a report.
+#define PROFILE_BUILD_KEY "PROFILE_BUILD"
+
+struct Toolchain;
+
+//! One compiler or linker run, times in microseconds since the compilation started
+struct ProfiledUnit
+{
+	ProfiledUnit();
+
+	QString name;
+	//! "compile", "pch" or "link"
+	QString category;
+	qint64 start;
+	qint64 end;
+	bool success;
+	//! Compiler phases (-ftime-report or clang's "Total ..." events) in milliseconds
+	QMap<QString, double> phases;
+	//! Headers in the order they were opened, with their nesting depth (from -H)
+	QList<QPair<QString, int> > includes;
+	//! Time clang spent in each header, in milliseconds. Empty for gcc.
+	QMap<QString, double> headerMsecs;
+
+	qint64 duration() const;
+};
+
+struct HeaderCost
+{
+	HeaderCost();
+
+	QString path;
+	//! Units that included the header at least once
+	int units;
+	//! Bytes parsed because of the header, its own includes counted, across all units
+	qint64 inclusiveBytes;
+	//! Only known for clang
+	double msecs;
+};
+
+/*!
+ * Collects how long each unit of a compilation took and what it included.
+ * Filled in from the compile chains' threads, read once the compilation is done.
+ */
+class BuildProfile
+{
+public:
+	BuildProfile();
+
+	//! Microseconds since the profile was created
+	qint64 elapsed() const;
+
+	//! Flags that make the compiler report where its time went
+	static QStringList flags(const Toolchain& toolchain);
+
+	//! Thread-safe
+	void addUnit(const ProfiledUnit& unit);
+	QList<ProfiledUnit> units() const;
+
+	/*!
+	 * Takes the -H header tree and the -ftime-report table out of a
+	 * compiler's stderr and records them in unit.
+	 * \return What is left, i.e. the diagnostics
+	 */
+	static QByteArray takeReport(const QByteArray& err, ProfiledUnit* unit);
+	//! Reads the .json written by clang's -ftime-trace into unit
+	static bool readTimeTrace(const QString& path, ProfiledUnit* unit);
+
+	QList<ProfiledUnit> slowestUnits(int count) const;
+	QList<HeaderCost> expensiveHeaders(int count) const;
+	//! The chain of units, one waiting on the next, that bounded the build's length
+	QList<ProfiledUnit> criticalPath() const;
+
+	QString report() const;
+	//! Chrome trace event format, viewable in chrome://tracing or Perfetto
+	QByteArray chromeTrace() const;
+	const bool save(const QString& path);
+	const QString& tracePath() const;
+
+private:
+	QElapsedTimer m_clock;
+	QList<ProfiledUnit> m_units;
+	QString m_tracePath;
+	mutable QMutex m_mutex;
+};
+
+/*!
+ * Runs another segment with its own session so that the profiling output
+ * can be separated from the diagnostics before they reach the chain.
+ */
+class ProfiledSegment : public ChainSegment
+{
+public:
+	/*!
+	 * \param timeTrace Where clang writes its -ftime-trace output for this unit, if anywhere
+	 */
+	ProfiledSegment(BuildProfile* profile, ChainSegment* segment, const QString& name,
+		const QString& category, const QString& timeTrace = QString());
+	~ProfiledSegment();
+
+	virtual const bool isErrorState() const;
+	virtual const bool run();
+	virtual void join();
+	virtual const bool running() const;
+	virtual const bool parallel() const;
+	virtual void finalize();
+	virtual void wait(int msecs);
+	virtual void cancel();
+private:
+	void markEnd() const;
+
+	BuildProfile* m_profile;
+	ChainSegment* m_segment;
+	const QString m_timeTrace;
+	ChainSession m_session;
+	mutable ProfiledUnit m_unit;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _BUILDPROFILETAB_H_
+#define _BUILDPROFILETAB_H_
+
+#include "Tab.h"
+
+#include <QWidget>
+
+class QPlainTextEdit;
+class QLabel;
+class MainWindow;
+
+//! Shows the report of a profiled compilation
+class BuildProfileTab : public QWidget, public TabbedWidget
+{
+	Q_OBJECT
+public:
+	BuildProfileTab(const QString& name, const QString& report, const QString& tracePath, MainWindow* parent = 0);
+	
+	void activate();
+	
+	bool beginSetup();
+	void completeSetup();
+	
+	bool close();
+	
+public slots:
+	void refreshSettings();
+	
+private:
+	QString m_name;
+	QString m_tracePath;
+	QPlainTextEdit* m_report;
+};
+
+#endif
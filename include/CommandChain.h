@@ -5,6 +5,67 @@
 #include <QIODevice>
 #include <QProcess>
 #include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+/*!
+ * Shared, thread-safe cancellation flag. Any thread may call cancel(); the
+ * thread executing a CommandChain polls isCancelled() between segments and
+ * while waiting on running segments. An optional deadline makes the token
+ * cancel itself once the given number of milliseconds has passed.
+ */
+class CancellationToken
+{
+public:
+	CancellationToken();
+	
+	void cancel();
+	const bool isCancelled() const;
+	
+	void setDeadline(qint64 msecs);
+	const bool hasDeadline() const;
+	const bool deadlineExpired() const;
+	
+	void reset();
+private:
+	QAtomicInt m_cancelled;
+	//! Guards m_deadline and m_timer, which are set and polled from different threads
+	mutable QMutex m_deadlineMutex;
+	qint64 m_deadline;
+	QElapsedTimer m_timer;
+};
+
+/*!
+ * Job slots shared by chains executing on different threads, so that several
+ * compilations running at once start no more processes than the machine has
+ * room for. Each running segment of a chain using the pool holds one slot.
+ */
+class JobPool
+{
+public:
+	JobPool(int jobs);
+	
+	//! Takes a slot, waiting at most msecs for one to be released
+	const bool tryAcquire(int msecs = 0);
+	void release();
+	
+	//! Sleeps for at most msecs, waking early when a slot is released
+	void wait(int msecs);
+	
+	int jobs() const;
+private:
+	QMutex m_mutex;
+	QWaitCondition m_released;
+	const int m_jobs;
+	int m_available;
+};
+
+class Cancellable
+{
+public:
+	virtual void cancel() = 0;
+};
 
 class ChainSession
 {
@@ -41,12 +102,31 @@ public:
 	virtual void join() = 0;
 	virtual void finalize() = 0;
 	
+	/*!
+	 * Blocks until the segment finishes or msecs pass. Nothing runs an event
+	 * loop while a chain executes, so this is also where segments notice they
+	 * have finished. The default only sleeps.
+	 */
+	virtual void wait(int msecs);
+	
 	virtual const bool parallel() const = 0;
 	
+	//! Stop the segment as quickly as possible. running() must become false soon after.
+	virtual void cancel() = 0;
+	
 	void setSession(ChainSession* session);
 	ChainSession* session();
+	
+	//! Maximum time in milliseconds the segment may run. 0 means no limit.
+	void setTimeout(qint64 msecs);
+	qint64 timeout() const;
+	
+	void startClock();
+	const bool timedOut() const;
 private:
 	ChainSession* m_session;
+	qint64 m_timeout;
+	QElapsedTimer m_clock;
 };
 
 class QThreadSegment : public ChainSegment
@@ -59,9 +139,12 @@ public:
 	virtual const bool running() const;
 	virtual void join();
 	virtual void finalize();
+	virtual void wait(int msecs);
 	
 	virtual const bool parallel() const;
 	virtual const bool isErrorState() const;
+	//! Threads that aren't Cancellable can't be asked to stop, so they are terminated
+	virtual void cancel();
 private:
 	QThread* m_thread;
 	bool m_transferOwnership;
@@ -85,10 +168,40 @@ public:
 	const Chain& chain() const;
 	
 	ChainSession* chainSession();
+	
+	//! The token is not owned by the chain. Pass 0 to disable cancellation.
+	void setCancellationToken(CancellationToken* token);
+	CancellationToken* cancellationToken() const;
+	
+	//! The pool is not owned by the chain. Pass 0 to only limit by maxConcurrentSegments().
+	void setJobPool(JobPool* pool);
+	JobPool* jobPool() const;
+	
+	//! Default timeout in milliseconds applied to segments that have none of their own
+	void setSegmentTimeout(qint64 msecs);
+	qint64 segmentTimeout() const;
+	
+	//! Maximum time in milliseconds for a single call to execute(). 0 means no limit.
+	void setTimeout(qint64 msecs);
+	qint64 timeout() const;
+	
+	//! \return true if the last execute() was stopped by cancellation or the chain timeout
+	const bool cancelled() const;
+	//! \return true if the last execute() had a segment or the chain exceed its timeout
+	const bool timedOut() const;
 private:
 	const bool executeNextSegment();
 	const bool updateExecuting();
 	const bool drainExecuting();
+	const bool shouldStop();
+	void cancelExecuting();
+	void discardChain();
+	
+	//! \return true if another segment may start now
+	const bool acquireJob();
+	void releaseJob();
+	//! Waits on the running segments between polls, at most a few milliseconds
+	void idle();
 	
 	quint16 m_maxConcurrentSegments;
 	
@@ -96,6 +209,20 @@ private:
 	Chain m_executing;
 	
 	ChainSession* m_chainSession;
+	
+	CancellationToken* m_token;
+	JobPool* m_jobPool;
+	qint64 m_segmentTimeout;
+	qint64 m_timeout;
+	QElapsedTimer m_clock;
+	bool m_cancelled;
+	bool m_timedOut;
+};
+
+class QProcessSegmentProcess : public QProcess
+{
+protected:
+	virtual void setupChildProcess();
 };
 
 class QProcessSegment : public ChainSegment
@@ -109,13 +236,16 @@ public:
 	virtual const bool running() const;
 	virtual const bool parallel() const;
 	virtual void finalize();
+	virtual void wait(int msecs);
+	virtual void cancel();
 	
 	QProcess* process();
 private:
 	const QString m_program;
 	const QStringList m_args;
 	bool m_parallel;
-	QProcess m_process;
+	bool m_cancelled;
+	QProcessSegmentProcess m_process;
 };
 
 class TimeSegment : public ChainSegment
@@ -128,8 +258,11 @@ public:
 	virtual void join();
 	virtual const bool running() const;
 	virtual const bool parallel() const;
+	virtual void wait(int msecs);
+	virtual void cancel();
 private:
 	long m_time;
+	bool m_cancelled;
 	QElapsedTimer timer;
 };
 
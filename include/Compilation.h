@@ -3,18 +3,39 @@
 
 #include "Project.h"
 #include "Compiler.h"
+#include "CommandChain.h"
+#include "Listenable.h"
 
 #include <QString>
 #include <QStringList>
 #include <QMap>
 #include <QSet>
 
-class Compilation
+// Optional project settings, both in milliseconds
+#define SEGMENT_TIMEOUT_KEY "SEGMENT_TIMEOUT"
+#define COMPILE_TIMEOUT_KEY "COMPILE_TIMEOUT"
+
+class Compilation;
+class BuildProfile;
+
+/*!
+ * Notified as each group of files is handed to a compiler. Callbacks happen
+ * on whichever thread called Compilation::start().
+ */
+struct CompilationListener
+{
+	virtual ~CompilationListener() {}
+	virtual void compilationUnitStarted(Compilation* compilation, const QString& compiler, const QStringList& files) = 0;
+	virtual void compilationUnitFinished(Compilation* compilation, const CompileResult& result) = 0;
+};
+
+class Compilation : public Listenable<CompilationListener>
 {
 public:
 	Compilation(const QList<Compiler*>& compilers, const QMap<QString, QString>& settings);
 	Compilation(const QList<Compiler*>& compilers, Project* project);
 	Compilation(const QList<Compiler*>& compilers, const QString& file);
+	~Compilation();
 	
 	void addFile(const QString& file, bool remove = false);
 	void addFiles(const QStringList& files, bool remove = false);
@@ -26,21 +47,53 @@ public:
 	
 	void setName(const QString& name);
 	const QString& name() const;
+	//! Project being compiled, or 0 for a single file. Only for comparing, it may have been closed since.
+	Project* project() const;
 	const QMap<QString, QString>& settings() const;
 	
 	const bool start();
+	
+	//! Thread-safe. Stops the running compilation as soon as possible.
+	void cancel();
+	const bool isCancelled() const;
+	CancellationToken* cancellationToken();
+	qint64 segmentTimeout() const;
+	
+	//! Pool shared with other compilations running at the same time. Not owned.
+	void setJobPool(JobPool* pool);
+	JobPool* jobPool() const;
+	
+	//! Applies this compilation's cancellation token, job pool and timeouts to a compiler's chain
+	void setupChain(CommandChain* chain);
+	
+	//! Toolchain for this compilation's target, picked by CompilerManager on first use
+	const Toolchain& toolchain();
+	
+	//! Turns profiling on or off. PROFILE_BUILD in the settings sets the default.
+	void setProfiling(bool profiling);
+	//! 0 unless this compilation is being profiled
+	BuildProfile* profile() const;
 protected:
 	const bool compile(const QStringList& files, Compiler* compiler);
 	Compiler* compilerFor(const QString& ext);
+	
+private:
+	const bool compileFiles();
 
 private:
 	QList<Compiler*> m_compilers;
 	QMap<QString, QString> m_settings;
 	QString m_name;
+	Project* m_project;
 	QSet<QString> m_files;
 	QStringList m_compileResults;
 	QStringList m_removes;
 	CompileResult m_results;
+	CancellationToken m_token;
+	JobPool* m_jobPool;
+	Toolchain m_toolchain;
+	bool m_toolchainResolved;
+	BuildProfile* m_profile;
 };
 
 #endif
@@ -0,0 +1,95 @@
+#ifndef _COMPILATIONSERVICE_H_
+#define _COMPILATIONSERVICE_H_
+
+#include "Singleton.h"
+#include "Compilation.h"
+#include "CommandChain.h"
+
+#include <QObject>
+#include <QThread>
+#include <QList>
+#include <QString>
+
+class CompilationThread : public QThread, public CompilationListener, public Cancellable
+{
+Q_OBJECT
+public:
+	//! Does not take ownership of compilation
+	CompilationThread(Compilation* compilation, QObject* parent = 0);
+	
+	Compilation* compilation() const;
+	const bool success() const;
+	
+	virtual void cancel();
+	
+	virtual void compilationUnitStarted(Compilation* compilation, const QString& compiler, const QStringList& files);
+	virtual void compilationUnitFinished(Compilation* compilation, const CompileResult& result);
+	
+signals:
+	void unitStarted(const QString& compiler, const QStringList& files);
+	void unitFinished(const CompileResult& result);
+	
+protected:
+	void run();
+	
+private:
+	Compilation* m_compilation;
+	bool m_success;
+};
+
+/*!
+ * Runs Compilations one at a time on a worker thread so the GUI stays
+ * responsive. All signals are emitted on the GUI thread. The Compilation
+ * passed to compilationFinished is deleted as soon as the signal returns.
+ * Every submitted Compilation gets a compilationFinished, including ones
+ * cancelled before they started.
+ */
+class CompilationService : public QObject, public Singleton<CompilationService>
+{
+Q_OBJECT
+public:
+	enum Policy {
+		//! Run after everything already submitted
+		Queue,
+		//! Cancel running and pending compilations with the same key
+		Supersede
+	};
+	
+	CompilationService();
+	~CompilationService();
+	
+	//! Takes ownership of compilation
+	void submit(Compilation* compilation, const QString& key, Policy policy = Supersede);
+	void cancel(const QString& key);
+	void cancelAll();
+	
+	const bool isBusy() const;
+	
+signals:
+	void compilationStarted(Compilation* compilation);
+	void unitStarted(Compilation* compilation, const QString& compiler, const QStringList& files);
+	void unitFinished(Compilation* compilation, const CompileResult& partial);
+	void compilationFinished(Compilation* compilation, bool success);
+	
+private slots:
+	void threadUnitStarted(const QString& compiler, const QStringList& files);
+	void threadUnitFinished(const CompileResult& result);
+	void threadFinished();
+	
+private:
+	struct Pending
+	{
+		Compilation* compilation;
+		QString key;
+	};
+	
+	//! Cancels a compilation that never started, tells its listeners and deletes it
+	void discard(Compilation* compilation);
+	void startNext();
+	
+	QList<Pending> m_pending;
+	CompilationThread* m_running;
+	QString m_runningKey;
+};
+
+#endif
@@ -22,24 +22,61 @@
 #define _COMPILER_H_
 
 #include "Singleton.h"
+#include "Diagnostic.h"
+#include "Toolchain.h"
 
 #include <QString>
 #include <QStringList>
 #include <QScriptValue>
 #include <QDir>
 #include <QMap>
+#include <QVector>
+#include <QMetaType>
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
 
+struct CompileOutputLine
+{
+	QString category;
+	QString message;
+};
+
+Q_DECLARE_TYPEINFO(CompileOutputLine, Q_MOVABLE_TYPE);
+
+/*!
+ * Output is stored as an append-only list of (category, message) pairs, so
+ * merging results only appends. categorizedOutput() is built from it on
+ * first use after a change. Copies are cheap since all members are
+ * implicitly shared.
+ */
 class CompileResult
 {
 public:
 	CompileResult(bool success, const QMap<QString, QStringList>& categorizedOutput, const QString& raw = QString());
-	CompileResult(bool success);
+	CompileResult(bool success = false);
 	
 	const bool success() const;
+	//! \return true if the compile was stopped early by cancellation or a timeout
+	const bool cancelled() const;
+	void setCancelled(bool cancelled);
 	const QString& raw() const;
 	const QStringList output(const QString& category) const;
 	const QMap<QString, QStringList>& categorizedOutput() const;
 	
+	void addOutput(const QString& category, const QString& message);
+	void addOutput(const QString& category, const QStringList& messages);
+	
+	//! Structured form of the errors and warnings in categorizedOutput(), when the compiler provides it
+	const DiagnosticList& diagnostics() const;
+	void setDiagnostics(const DiagnosticList& diagnostics);
+	//! Diagnostics in the file at path, compared as clean absolute paths. Indexed once per change.
+	const DiagnosticList diagnosticsForFile(const QString& path) const;
+	
+	//! Milliseconds spent in named stages, such as "link". Merging results adds them up.
+	const QMap<QString, qint64>& timings() const;
+	void addTiming(const QString& stage, qint64 msecs);
+	
 	void clear();
 	
 	void addCompileResult(const CompileResult& rhs);
@@ -47,10 +84,21 @@ public:
 	CompileResult operator+(const CompileResult& rhs) const;
 private:
 	bool m_success;
-	QMap<QString, QStringList> m_categorizedOutput;
+	bool m_cancelled;
+	QVector<CompileOutputLine> m_output;
+	DiagnosticList m_diagnostics;
+	QMap<QString, qint64> m_timings;
 	QString m_raw;
+	
+	mutable QMap<QString, QStringList> m_categorizedOutput;
+	mutable bool m_categorizedDirty;
+	mutable QMap<QString, DiagnosticList> m_diagnosticsByFile;
+	mutable bool m_diagnosticsDirty;
 };
 
+Q_DECLARE_METATYPE(CompileResult)
+
+class QIODevice;
 class Compilation;
 class Compiler;
 
@@ -60,6 +108,12 @@ public:
 	void addCompiler(Compiler* compiler);
 	void removeCompiler(Compiler* compiler);
 	const QList<Compiler*>& compilers() const;
+	
+	/*!
+	 * Toolchain compilers should run for a target: the preferred one if it
+	 * exists, otherwise the target's own or the system gcc (see ToolchainRegistry).
+	 */
+	Toolchain toolchain(const QString& target, const QString& preferred = QString()) const;
 private:
 	QList<Compiler*> m_compilers;
 };
@@ -82,15 +136,89 @@ private:
 	QStringList m_types;
 };
 
+//! One command requested by a script compiler. It starts once every job named in dependsOn has finished.
+struct ScriptCompileJob
+{
+	QString id;
+	QString program;
+	QStringList args;
+	QString workingDirectory;
+	QStringList dependsOn;
+};
+
+/*!
+ * What a script's compile(files, settings, outputDirectory) returns, either
+ * as a bare array of jobs or as an object:
+ * 
+ *   { jobs: [{ id, program, args, workingDirectory, dependsOn }],
+ *     outputs: ["main.o"],  // added to the compilation for the next compiler
+ *     parser: "gcc" }       // "gcc", "gcc-json", "linker" or omitted for plain text
+ */
+struct ScriptCompilePlan
+{
+	QList<ScriptCompileJob> jobs;
+	QStringList outputs;
+	QString parser;
+	//! Set instead of jobs when the script failed
+	QString error;
+};
+
+/*!
+ * Calls the script's compile function on the thread that owns its engine,
+ * since QScriptEngine may only be used there.
+ */
+class CompilerPluginInvoker : public QObject
+{
+Q_OBJECT
+public:
+	CompilerPluginInvoker(const QScriptValue& plugin);
+	
+	//! Blocks until the script has answered or the compilation is cancelled
+	ScriptCompilePlan plan(Compilation* compilation, const QStringList& files, const QString& outputDirectory);
+	
+	static ScriptCompilePlan planFromScript(const QScriptValue& value, const QString& outputDirectory);
+	
+private slots:
+	void invoke();
+	
+private:
+	QScriptValue m_plugin;
+	
+	QMutex m_callMutex;
+	QMutex m_mutex;
+	QWaitCondition m_finishedCondition;
+	bool m_pending;
+	bool m_finished;
+	QStringList m_files;
+	QMap<QString, QString> m_settings;
+	QString m_outputDirectory;
+	ScriptCompilePlan m_plan;
+};
+
+/*!
+ * Compiler defined by a script. The script only plans the work; the jobs
+ * run on a CommandChain on the compilation thread like any native compiler's.
+ */
 class CompilerPlugin : public Compiler
 {
 public:
 	CompilerPlugin(const QScriptValue& plugin);
+	~CompilerPlugin();
 
 	virtual CompileResult compile(Compilation* compilation, const QStringList& files);
 	
+	/*!
+	 * Groups jobs into levels. Every job's dependencies are in an earlier
+	 * level, so the jobs within a level can run in parallel.
+	 * \return An empty list and error set if a dependency is unknown or circular
+	 */
+	static QList<QList<ScriptCompileJob> > schedule(const QList<ScriptCompileJob>& jobs, QString* error);
+	
 private:
+	CompileResult parseOutput(const QString& parser, QIODevice* err, bool success) const;
+	
 	QScriptValue m_plugin;
+	CompilerPluginInvoker* m_invoker;
 };
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef _DIAGNOSTIC_H_
+#define _DIAGNOSTIC_H_
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+struct DiagnosticNote
+{
+	DiagnosticNote();
+	
+	QString toString() const;
+	
+	QString file;
+	int line;
+	int column;
+	QString message;
+};
+
+//! Replace [line:column, endLine:endColumn) with replacement
+struct DiagnosticFixit
+{
+	DiagnosticFixit();
+	
+	int line;
+	int column;
+	int endLine;
+	int endColumn;
+	QString replacement;
+};
+
+/*!
+ * A single compiler message. line and column are 1-based; 0 means the
+ * compiler did not report one. context holds the raw lines gcc prints around
+ * a diagnostic ("In function ...", source excerpts, carets).
+ */
+struct Diagnostic
+{
+	enum Severity {
+		Error,
+		Warning,
+		Note
+	};
+	
+	Diagnostic();
+	
+	//! \return file:line:column: severity: message with the directory stripped from file
+	QString toString() const;
+	static QString severityName(Severity severity);
+	
+	QString file;
+	int line;
+	int column;
+	//! End of the highlighted range, if the compiler reported one
+	int endLine;
+	int endColumn;
+	Severity severity;
+	QString message;
+	QList<DiagnosticNote> notes;
+	QList<DiagnosticFixit> fixits;
+	QStringList context;
+};
+
+typedef QList<Diagnostic> DiagnosticList;
+
+#endif
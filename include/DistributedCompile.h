@@ -0,0 +1,241 @@
+#ifndef _DISTRIBUTEDCOMPILE_H_
+#define _DISTRIBUTEDCOMPILE_H_
+
+#include "CommandChain.h"
+#include "Toolchain.h"
+
+#include <QObject>
+#include <QMap>
+#include <QList>
+#include <QStringList>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QPair>
+
+class QTcpSocket;
+class QTcpServer;
+
+#define COMPILE_DAEMON_PROGRAM "kiss_compile_daemon"
+#define COMPILE_DAEMON_DEFAULT_PORT 3633
+// Largest preprocessed source or object either side will uncompress
+#define COMPILE_DAEMON_MAX_FILE_BYTES (128 * 1024 * 1024)
+// Jobs a daemon queues per slot before it refuses more
+#define COMPILE_DAEMON_QUEUE_PER_SLOT 4
+// Largest frame either side accepts. A peer announcing a larger one is disconnected.
+#define COMPILE_DAEMON_MAX_FRAME_BYTES (64 * 1024 * 1024)
+
+/*
+ * Wire protocol. Every frame is a quint32 byte count followed by a QDataStream
+ * payload that starts with a quint8 frame type.
+ *   Status:        (empty)
+ *   StatusReply:   quint32 jobSlots, quint32 load
+ *   Compile:       QString family, QString version, QString machine, QStringList args,
+ *                  QByteArray qCompress()ed preprocessed source
+ *   CompileReply:  qint32 exitCode, bool crashed, QByteArray qCompress()ed object, QByteArray err
+ *   Refused:       QByteArray reason
+ *
+ * The toolchain identity in Compile comes from the client's Toolchain. A daemon
+ * whose compiler differs refuses the job, and the client compiles it locally.
+ */
+namespace DistributedProtocol
+{
+	enum FrameType {
+		Status = 1,
+		StatusReply,
+		Compile,
+		CompileReply,
+		Refused
+	};
+
+	QByteArray frame(const QByteArray& payload);
+	//! Removes one complete frame from the front of buffer. \return false if buffer holds no complete frame
+	bool takeFrame(QByteArray& buffer, QByteArray& payload);
+	//! \return true if the frame at the front of buffer is larger than COMPILE_DAEMON_MAX_FRAME_BYTES
+	bool oversized(const QByteArray& buffer);
+
+	/*!
+	 * Daemons only accept code generation and warning flags. Anything that
+	 * names files or loads code on the daemon's machine is refused.
+	 */
+	bool isRemoteArgument(const QString& arg);
+
+	/*!
+	 * qUncompress() that refuses data announcing more than
+	 * COMPILE_DAEMON_MAX_FILE_BYTES and never grows past what was announced.
+	 */
+	bool uncompress(const QByteArray& data, QByteArray& out);
+}
+
+struct CompileHost
+{
+	CompileHost();
+
+	QString address;
+	quint16 port;
+	//! Address the daemon answered on, so that jobs don't look the name up again
+	QHostAddress resolved;
+	//! Jobs the daemon runs at once
+	quint32 jobSlots;
+	//! Daemon's queued and running jobs (or system load, if higher) when last asked
+	quint32 load;
+	//! Jobs this pool has on the host right now
+	quint32 assigned;
+	bool up;
+};
+
+/*!
+ * Picks where each job runs: the least loaded of the local machine and the
+ * reachable daemons. Used by one compilation thread at a time.
+ */
+class CompileHostPool
+{
+public:
+	CompileHostPool(const QStringList& hosts, quint16 localSlots);
+
+	//! Asks every daemon for its load, all at once, waiting at most msecs
+	void refresh(int msecs = 500);
+
+	//! \return Host index, or -1 to run the job locally
+	int acquire();
+	void release(int host);
+	//! Stops handing jobs to a host for the rest of this pool's life
+	void markDown(int host);
+
+	const CompileHost& host(int host) const;
+	const QList<CompileHost>& hosts() const;
+	quint16 localSlots() const;
+	//! Local slots plus the slots of every reachable daemon
+	quint32 totalSlots() const;
+
+	//! "host[:port]" entries separated by commas or whitespace
+	static QStringList parseHosts(const QString& spec);
+private:
+	QList<CompileHost> m_hosts;
+	quint16 m_localSlots;
+	quint16 m_localAssigned;
+};
+
+/*!
+ * Compiles "<flags> -c file -o object" on a compile daemon. The file is
+ * preprocessed here, sent along with the remaining flags, and the object
+ * written back. Whenever that isn't possible (no remote slot, preprocessing
+ * errors, the daemon going away) the local segment runs instead.
+ */
+class DistributedSegment : public ChainSegment
+{
+public:
+	DistributedSegment(CompileHostPool* pool, ChainSegment* local, const Toolchain& toolchain,
+		const QString& workingDirectory, const QStringList& args);
+	~DistributedSegment();
+
+	virtual const bool isErrorState() const;
+	virtual const bool run();
+	virtual void join();
+	virtual const bool running() const;
+	virtual const bool parallel() const;
+	virtual void finalize();
+	virtual void wait(int msecs);
+	virtual void cancel();
+
+	//! true if the job was compiled by a daemon
+	const bool remote() const;
+private:
+	enum State {
+		Idle,
+		Preprocessing,
+		Connecting,
+		Remote,
+		Local,
+		Done
+	};
+
+	//! Moves the job along without blocking. \return true while work remains
+	const bool update();
+	const bool runLocally();
+	//! Starts connecting to the host. The job is sent once update() sees the connection.
+	const bool sendToHost();
+	//! \return false if the daemon refused the job or failed to run the compiler at all
+	const bool readReply();
+	void releaseHost();
+
+	CompileHostPool* m_pool;
+	ChainSegment* m_local;
+	const Toolchain m_toolchain;
+	const QString m_workingDirectory;
+	const QStringList m_args;
+
+	State m_state;
+	int m_host;
+	//! Whether m_host (or the local machine, for -1) still counts this job
+	bool m_acquired;
+	bool m_cancelled;
+	bool m_remote;
+	QString m_source;
+	QString m_object;
+	QStringList m_flags;
+	QProcess* m_preprocess;
+	QTcpSocket* m_socket;
+	QElapsedTimer m_connectClock;
+	QByteArray m_request;
+	QByteArray m_buffer;
+	qint32 m_exitCode;
+	QByteArray m_err;
+};
+
+/*!
+ * Compile daemon run on every machine that lends its CPU. Preprocessed
+ * sources are compiled in a scratch directory and only the object and the
+ * compiler's stderr are sent back. Jobs for another toolchain are refused,
+ * as are clients outside the allowed subnets.
+ */
+class CompileDaemon : public QObject
+{
+Q_OBJECT
+public:
+	CompileDaemon(const QString& program, quint16 jobSlots = 0, QObject* parent = 0);
+	~CompileDaemon();
+
+	const bool listen(const QHostAddress& address, quint16 port = COMPILE_DAEMON_DEFAULT_PORT);
+	quint16 port() const;
+
+	//! Only clients in one of these subnets may connect. Everyone may when it is empty.
+	void setAllowed(const QList<QPair<QHostAddress, int> >& subnets);
+
+	//! Jobs compiled since start, for tests and logging
+	quint32 completed() const;
+
+private slots:
+	void newConnection();
+	void readClient();
+	void clientDisconnected();
+	void jobFinished();
+
+private:
+	struct Job
+	{
+		QTcpSocket* client;
+		QStringList args;
+		QString directory;
+		QProcess* process;
+	};
+
+	void handleFrame(QTcpSocket* client, const QByteArray& payload);
+	void reply(Job* job, qint32 exitCode, bool crashed, const QByteArray& object, const QByteArray& err);
+	void refuse(QTcpSocket* client, const QByteArray& reason);
+	const bool isAllowed(const QHostAddress& address) const;
+	void startJobs();
+	void removeJob(Job* job);
+	quint32 load() const;
+
+	Toolchain m_toolchain;
+	quint16 m_jobSlots;
+	QList<QPair<QHostAddress, int> > m_allowed;
+	QTcpServer* m_server;
+	QMap<QTcpSocket*, QByteArray> m_buffers;
+	QList<Job*> m_queued;
+	QList<Job*> m_running;
+	quint32 m_nextJob;
+	quint32 m_completed;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _DISTRIBUTEDCOMPILERC_H_
+#define _DISTRIBUTEDCOMPILERC_H_
+
+#include "TestCompilerC.h"
+
+#include <QThreadStorage>
+
+/*
+ * Project setting. Compile daemons to share the work with as "host[:port]"
+ * entries separated by commas or spaces. The KISS_COMPILE_HOSTS environment
+ * variable is used when a project doesn't set it.
+ */
+#define COMPILE_HOSTS_KEY "COMPILE_HOSTS"
+#define COMPILE_HOSTS_ENV "KISS_COMPILE_HOSTS"
+// Environment variable choosing the C compiler on Unix. "distributed" selects DistributedCompilerC.
+#define COMPILE_BACKEND_ENV "KISS_COMPILE_BACKEND"
+
+class CompileHostPool;
+
+/*!
+ * Sends object compiles to kiss_compile_daemons on other machines when they
+ * are less loaded than this one. Everything else, and every job no daemon
+ * can take, is compiled as TestCompilerC would.
+ */
+class DistributedCompilerC : public TestCompilerC
+{
+public:
+	virtual CompileResult compile(Compilation* compilation, const QStringList& files);
+protected:
+	virtual ChainSegment* createGccSegment(Compilation* compilation, const QStringList& args);
+	virtual quint16 concurrency();
+private:
+	QThreadStorage<CompileHostPool*> m_pools;
+};
+
+#endif
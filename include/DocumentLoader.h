@@ -0,0 +1,72 @@
+#ifndef _DOCUMENTLOADER_H_
+#define _DOCUMENTLOADER_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QTimer>
+#include <QPointer>
+
+class QsciScintilla;
+class QsciLexer;
+class QTextCodec;
+class QTextDecoder;
+
+/*!
+ * Fills an editor with a document a chunk at a time, so opening a large file
+ * doesn't freeze the UI. Files are mapped rather than read, text already in
+ * the editor's encoding is appended without conversion, and the first chunk
+ * is shown right away. The rest follows whenever the event loop is idle.
+ *
+ * The editor is read only until everything is in, and its lexer is detached
+ * so chunks aren't styled as they arrive. Loading doesn't count as a
+ * modification and can't be undone.
+ */
+class DocumentLoader : public QObject
+{
+Q_OBJECT
+public:
+	DocumentLoader(QsciScintilla* editor, QObject* parent = 0);
+	~DocumentLoader();
+	
+	//! Replaces the editor's text with the file's, decoded like QTextStream would
+	const bool loadFile(const QString& path);
+	//! Replaces the editor's text with data, decoded like a QString constructed from it would
+	void load(const QByteArray& data);
+	
+	const bool isLoading() const;
+	//! Appends everything that's left right away, for callers that need the whole text
+	void finish();
+	
+	//! Attaches lexer to the editor, once loading has finished
+	void setLexer(QsciLexer* lexer);
+	
+signals:
+	void finished();
+	
+private slots:
+	void loadChunks();
+	
+private:
+	void start(const QByteArray& data, QTextCodec* codec);
+	void appendChunk();
+	void done();
+	//! Drops the data being loaded and unmaps the file it came from
+	void releaseData();
+	
+	QsciScintilla* m_editor;
+	QTimer m_timer;
+	
+	QFile m_file;
+	uchar* m_map;
+	QByteArray m_data;
+	int m_pos;
+	//! 0 when the data is already in the editor's encoding
+	QTextDecoder* m_decoder;
+	
+	bool m_loading;
+	bool m_readOnly;
+	QPointer<QsciLexer> m_lexer;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _EDITORSETTINGS_H_
+#define _EDITORSETTINGS_H_
+
+#include <QFont>
+
+#define EDITOR "Editor"
+#define FONT "font"
+#define ENABLED "enabled"
+#define FONT_SIZE "fontsize"
+#define AUTO_COMPLETION "autocompletion"
+#define API_SOURCE "apisource"
+#define DOC_SOURCE "docsource"
+#define THRESHOLD "threshold"
+#define STYLE "style"
+#define MAINTAIN "Maintain"
+#define INTELLIGENT "Intelligent"
+#define CALL_TIPS "calltips"
+#define LINE_NUMBERS "linenumbers"
+#define WIDTH "width"
+#define AUTO_INDENT "autoindent"
+#define BRACE_MATCHING "bracematching"
+#define DEBUGGER_ENABLED "debugger_enabled"
+
+/*!
+ * Everything EditorSettingsDialog configures. The current settings are read
+ * from QSettings once and then kept in memory. Their version changes whenever
+ * different settings are published, so an editor can tell whether it has
+ * anything to apply.
+ */
+struct EditorSettings
+{
+	EditorSettings();
+	
+	QFont font;
+	
+	bool autoCompletion;
+	bool apiSource;
+	bool documentSource;
+	int autoCompletionThreshold;
+	
+	bool autoIndent;
+	//! Keep the previous line's indentation instead of indenting by block
+	bool maintainIndent;
+	int indentWidth;
+	
+	bool callTips;
+	bool braceMatching;
+	bool lineNumbers;
+	bool debuggerEnabled;
+	
+	int version;
+	
+	//! Compares the settings, not their versions
+	const bool operator==(const EditorSettings& rhs) const;
+	const bool operator!=(const EditorSettings& rhs) const;
+	
+	static const EditorSettings& current();
+	//! Saves settings and makes them current, under a new version if they changed
+	static void publish(const EditorSettings& settings);
+	
+private:
+	static EditorSettings read();
+	void write() const;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _FINDINFILES_H_
+#define _FINDINFILES_H_
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMetaType>
+
+class Project;
+
+struct FindInFilesMatch
+{
+	//! The project's name and the file's path in it, or the file's path on disk
+	QString location;
+	//! 0 for files on disk
+	Project* project;
+	//! In the project's archive or on disk
+	QString path;
+	//! From 1
+	int line;
+	//! Characters into the line, from 0
+	int column;
+	int length;
+	QString text;
+};
+
+typedef QList<FindInFilesMatch> FindInFilesMatchList;
+Q_DECLARE_METATYPE(FindInFilesMatchList)
+
+/*!
+ * Searches the files of projects and files on disk, several at once on a
+ * thread pool of its own. Matches are reported while the search runs, and a
+ * cancelled search stops within a line of every file being searched.
+ * Project files are copied out of their archives when added, so a project
+ * can be edited while it's searched.
+ */
+class FindInFiles : public QObject
+{
+Q_OBJECT
+public:
+	FindInFiles(QObject* parent = 0);
+	~FindInFiles();
+	
+	//! Every file in project is searched by the next start()
+	void addProject(Project* project);
+	void addFile(const QString& path);
+	
+	//! Searches everything added since the last search, one match per line. \return false if query is invalid
+	const bool start(const QString& query, const bool regularExpression, const bool caseSensitive);
+	void cancel();
+	const bool isRunning() const;
+	
+signals:
+	void found(const FindInFilesMatchList& matches);
+	void finished(const bool cancelled);
+	
+private slots:
+	void matchesFound(int search, const FindInFilesMatchList& matches);
+	void fileSearched(int search);
+	
+private:
+	struct Source
+	{
+		QString location;
+		Project* project;
+		QString path;
+		//! Empty for files on disk, which are read by the search itself
+		QByteArray data;
+	};
+	
+	class Task;
+	friend class Task;
+	
+	QThreadPool m_pool;
+	QList<Source> m_sources;
+	QAtomicInt m_cancelled;
+	//! Tells results of the current search from those of cancelled ones still on their way
+	int m_search;
+	int m_remaining;
+};
+
+#endif
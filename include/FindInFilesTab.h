@@ -0,0 +1,58 @@
+#ifndef _FINDINFILESTAB_H_
+#define _FINDINFILESTAB_H_
+
+#include "Tab.h"
+#include "FindInFiles.h"
+
+#include <QWidget>
+#include <QModelIndex>
+
+class QLineEdit;
+class QCheckBox;
+class QPushButton;
+class QLabel;
+class QTreeView;
+class QStandardItemModel;
+class MainWindow;
+
+//! Searches the files of every open project and every file open on disk
+class FindInFilesTab : public QWidget, public TabbedWidget
+{
+	Q_OBJECT
+public:
+	FindInFilesTab(MainWindow* parent = 0);
+	
+	void activate();
+	
+	bool beginSetup();
+	void completeSetup();
+	
+	bool close();
+	
+public slots:
+	void refreshSettings();
+	
+private slots:
+	void search();
+	void found(const FindInFilesMatchList& matches);
+	void finished(const bool cancelled);
+	void open(const QModelIndex& index);
+	
+private:
+	void updateStatus(const QString& state);
+	
+	FindInFiles m_find;
+	//! Matches shown, by row
+	FindInFilesMatchList m_matches;
+	bool m_truncated;
+	
+	QLineEdit* m_query;
+	QCheckBox* m_regularExpression;
+	QCheckBox* m_matchCase;
+	QPushButton* m_search;
+	QLabel* m_status;
+	QTreeView* m_results;
+	QStandardItemModel* m_model;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _FINDINDEX_H_
+#define _FINDINDEX_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+
+class QsciScintilla;
+
+/*!
+ * Every match of a search in an editor, found in one pass over Scintilla's
+ * buffer and highlighted with an indicator. Edits only rescan the text
+ * around them, so the index and the highlights stay current while typing.
+ * Positions are Scintilla byte positions.
+ */
+class FindIndex : public QObject
+{
+Q_OBJECT
+public:
+	FindIndex(QsciScintilla* editor, QObject* parent = 0);
+	
+	//! Indexes and highlights every match of text. Nothing matches an empty text.
+	void setQuery(const QString& text, const bool caseSensitive);
+	void clear();
+	
+	int count() const;
+	int matchStart(int match) const;
+	int matchLength() const;
+	
+	//! \return The first match starting at or after pos, wrapping around, or -1 if there are none
+	int matchAfter(int pos) const;
+	//! \return true if [start, end) is a match
+	const bool isMatch(int start, int end) const;
+	
+	//! Replaces the selection if it's a match. \return true if it was
+	const bool replaceSelection(const QString& replacement);
+	//! Replaces every match not overlapping an earlier one, as one undo action. \return Matches replaced
+	int replaceAll(const QString& replacement);
+	
+private slots:
+	void modified(int position, int modificationType, const char* text, int length, int linesAdded,
+		int line, int foldLevelNow, int foldLevelPrev, int token, int annotationLinesAdded);
+	
+private:
+	//! Appends the matches in text, which starts at position base, to matches
+	void search(const char* text, int base, int length, QVector<int>* matches) const;
+	//! Lets Scintilla find the matches in [start, end), for case insensitive non-ASCII text
+	void searchScintilla(int start, int end, QVector<int>* matches) const;
+	//! Finds the matches starting in [start, end)
+	QVector<int> searchRange(int start, int end) const;
+	const bool matchesAt(const char* text) const;
+	
+	void reindex();
+	//! Redraws the highlights in [start, end)
+	void highlight(int start, int end);
+	//! In the editor's encoding
+	QByteArray encode(const QString& text) const;
+	
+	QsciScintilla* m_editor;
+	int m_indicator;
+	
+	//! In the editor's encoding. Lower case unless m_caseSensitive.
+	QByteArray m_needle;
+	bool m_caseSensitive;
+	//! Set when the needle is found by Scintilla, which folds the case of non-ASCII text
+	bool m_scintilla;
+	
+	//! Start of every match, in order. Matches may overlap.
+	QVector<int> m_matches;
+	//! Set while replacing, which reindexes once when done
+	bool m_replacing;
+};
+
+#endif
@@ -2,10 +2,12 @@
 #define _GCCOUTPUT_H_
 
 #include "Compiler.h"
+#include "Diagnostic.h"
 
 #include <QMap>
 #include <QString>
 #include <QStringList>
+#include <QByteArray>
 
 class QIODevice;
 
@@ -13,7 +15,19 @@ class GccOutput
 {
 public:
 	static CompileResult processCompilerOutput(QIODevice* in);
+	//! For output of gcc -fdiagnostics-format=json. Lines that aren't JSON are parsed as text.
+	static CompileResult processJsonCompilerOutput(QIODevice* in);
 	static CompileResult processLinkerOutput(QIODevice* in);
+	
+	/*!
+	 * Single pass over gcc's stderr. Notes are attached to the diagnostic they
+	 * follow, as is anything printed after the last diagnostic.
+	 */
+	static DiagnosticList parseCompilerOutput(const QByteArray& data);
+	static DiagnosticList parseJsonCompilerOutput(const QByteArray& data, QByteArray* nonJson = 0);
+	
+	//! Builds the categorized error and warning lists from already parsed diagnostics
+	static CompileResult compileResult(const DiagnosticList& diagnostics, const QString& raw);
 };
 
 #endif
@@ -68,6 +68,8 @@ public:
 	bool openFile(const QString& filePath);
 	bool memoryOpen(const QByteArray& ba, const QString& assocPath);
 	bool openProject(const QString& filePath);
+	//! Switches to the file's tab, opening one if needed. \return 0 if it couldn't be opened
+	SourceFile* openProjectFile(Project* project, const TinyNode* node);
 	bool newProject(const QString& filePath);
 	
 	void initMenus(TabbedWidget* tab);
@@ -178,6 +180,7 @@ public slots:
 	void settings();
 	void managePackages();
 	void installLocalPackage();
+	void findInFiles();
 	
 	void showProjectDock(bool show = true);
 	void hideProjectDock();
@@ -195,6 +198,7 @@ private slots:
 	void openRecent();
 	
 	void errorClicked(QListWidgetItem* item);
+	void diagnosticActivated(const QString& file, int line, int column);
 	
 	void showContextMenuForError(const QPoint &pos);
 	
@@ -30,6 +30,7 @@
 #include "Debugger.h"
 
 #include "WorkingUnit.h"
+#include "Compiler.h"
 
 #include "SourceFindWidget.h"
 #include "SourceLocalFailed.h"
@@ -47,6 +48,8 @@
 #include <QObject>
 #include <QMenuBar>
 #include <QToolBar>
+#include <QFont>
+#include <QMap>
 
 #define UI_EVENT_FILE_SAVE "save"
 #define UI_EVENT_FILE_SAVE_AS "saveAs"
@@ -71,16 +74,24 @@
 
 class FindDialog;
 class MainWindow;
+class Compilation;
+class BlockIndenter;
+class DocumentLoader;
 class Project;
 class TinyNode;
 
-namespace Lexer { struct Constructor; }
+namespace Lexer
+{
+	struct Constructor;
+	struct LexerBase;
+}
 
 class SourceFile : public QWidget, public TabbedWidget, public WorkingUnit, private Ui::SourceFile
 {
 Q_OBJECT
 public:
 	SourceFile(MainWindow* parent = 0);
+	~SourceFile();
 	
 	void activate();
 	
@@ -107,6 +118,9 @@ public:
 	int currentLine() const;
 	bool breakpointOnLine(int line) const;
 	
+	//! Clean absolute path this file is handed to the compiler as, and that its diagnostics name
+	QString compiledPath();
+	
 	static SourceFile* newProjectFile(MainWindow* mainWindow, Project* project);
 	
 public slots:
@@ -161,6 +175,13 @@ signals:
 
 private slots:
 	void on_ui_editor_cursorPositionChanged(int line, int index);
+	void linesChanged();
+	
+	void compilationUnitStarted(Compilation* compilation, const QString& compiler, const QStringList& files);
+	void compilationUnitFinished(Compilation* compilation, const CompileResult& partial);
+	void compilationFinished(Compilation* compilation, bool success);
+	
+	void autoIndent(int character);
 	
 private:
 	bool saveAsFile();
@@ -169,13 +190,30 @@ private:
 	void showFind();
 	bool checkPort();
 	
-	void setLexer(Lexer::Constructor* constructor);
+	void setLexer(const Lexer::Constructor* constructor);
+	//! The part of the settings that lives in the lexer, which setLexer() replaces
+	void applyLexerSettings();
+	//! Auto-indent style the settings ask lexers of this editor to have
+	static int lexerIndentStyle();
+	
+	//! Digits the line number margin has room for
+	static int lineDigits(int lines);
+	//! Width of a digit in the margin at the current zoom
+	int digitWidth();
 	
 	bool m_isNewFile;
 	int m_zoomLevel;
         void dropEvent(QDropEvent *event);
 
 	QString m_lexAPI;
+	//! Shared with other tabs through Lexer::Factory::acquire()
+	Lexer::LexerBase* m_lexer;
+	//! Of the EditorSettings last applied
+	int m_settingsVersion;
+	int m_marginDigits;
+	//! Font digitWidth() measured, and its digit widths by zoom level
+	QFont m_marginFont;
+	QMap<int, int> m_digitWidths;
 	QString m_targetName;
 	QString m_templateExt;
 	
@@ -188,13 +226,24 @@ private:
 	
 	QList<int> m_breakpoints;
 	
+	// The compilation this file last submitted, only used to recognize its signals
+	Compilation* m_compilation;
+	CompileResult m_partialResults;
+	
 	int m_currentLine;
+	BlockIndenter* m_indenter;
+	DocumentLoader* m_loader;
 	QWidget* m_runTab;
 	
 	//QsciAPIs m_apis;
 	
-	void clearProblems();
-	void markProblems(const QStringList& errors, const QStringList& warnings);
+	/*!
+	 * Brings the error and warning markers in line with results, touching only
+	 * lines that differ. Markers results doesn't have are kept unless removeStale.
+	 */
+	void markProblems(const CompileResult& results, const bool removeStale);
+	//! Whether compilation builds this file, either started here or for the project it belongs to
+	const bool isCompiledBy(Compilation* compilation);
 	void updateErrors();
 	
 	Debugger m_debugger;
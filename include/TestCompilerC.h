@@ -3,7 +3,13 @@
 
 #include "Compiler.h"
 
-class QProcessSegment;
+// Project setting. Set to "false" to disable automatic precompiled headers.
+#define PRECOMPILED_HEADERS_KEY "PRECOMPILED_HEADERS"
+// Project settings. UNITY_BUILD set to "true" compiles files in batches of UNITY_BATCH_SIZE.
+#define UNITY_BUILD_KEY "UNITY_BUILD"
+#define UNITY_BATCH_SIZE_KEY "UNITY_BATCH_SIZE"
+
+class ChainSegment;
 
 class TestCompilerC : public Compiler
 {
@@ -11,9 +17,33 @@ public:
 	TestCompilerC();
 	
 	virtual CompileResult compile(Compilation* compilation, const QStringList& files);
+protected:
+	//! Every compiler invocation, including PCH builds, goes through here
+	virtual ChainSegment* createGccSegment(Compilation* compilation, const QStringList& args);
+	//! Segments a compile chain runs at once
+	virtual quint16 concurrency();
+	
 private:
-	QProcessSegment* createGccSegment(const QStringList& args);
-	static QString gccPath();
+	//! createGccSegment(), timed when the compilation is being profiled
+	ChainSegment* createUnitSegment(Compilation* compilation, const QStringList& args, const QString& name,
+		const QString& category, const QString& object);
+	CompileResult compileUnits(Compilation* compilation, const QStringList& files, const QStringList& flags, bool json);
+	/*!
+	 * Compiles files #included together into generated sources. Batches that
+	 * fail are compiled again file by file, so only their per-file diagnostics are kept.
+	 */
+	CompileResult compileUnity(Compilation* compilation, const QStringList& files, const QStringList& flags, bool json);
+	QString writeUnitySource(const QStringList& files);
+	static CompileResult processOutput(QIODevice* err, bool json);
+	
+	/*!
+	 * Builds (or reuses) a precompiled header for the #include <...> lines
+	 * every file starts with.
+	 * \return Path to pass to -include, or an empty string if there is no usable PCH
+	 */
+	QString precompiledHeader(Compilation* compilation, const QStringList& files, const QStringList& flags);
+	static QStringList includePrefix(const QString& file);
+	static bool isPrecompiledHeaderCurrent(const QString& header);
 };
 
 #endif
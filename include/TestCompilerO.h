@@ -3,6 +3,9 @@
 
 #include "Compiler.h"
 
+// Project setting. "gold", "lld" or "bfd" to pick a linker, otherwise the fastest the toolchain has is used.
+#define LINKER_KEY "LINKER"
+
 class QProcessSegment;
 
 class TestCompilerO : public Compiler
@@ -12,8 +15,18 @@ public:
 	
 	virtual CompileResult compile(Compilation* compilation, const QStringList& files);
 private:
-	QProcessSegment* createGccSegment(const QStringList& args);
-	static QString gccPath();
+	QProcessSegment* createGccSegment(Compilation* compilation, const QStringList& args);
+	
+	/*!
+	 * Hash of everything that goes into a link: the toolchain, flags and each
+	 * input's path and contents. Empty if an input can't be read.
+	 */
+	static QByteArray linkSignature(Compilation* compilation, const QStringList& args, const QStringList& files);
+	bool isLinkCurrent(const QString& executable, const QByteArray& signature);
+	void writeLinkStamp(const QString& executable, const QByteArray& signature);
+	
+	//! -fuse-ld flag for the fastest linker the toolchain can use
+	static QString fastLinkerFlag(Compilation* compilation);
 };
 
 #endif
@@ -0,0 +1,90 @@
+#ifndef _TOOLCHAIN_H_
+#define _TOOLCHAIN_H_
+
+#include "Singleton.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+
+class QSettings;
+
+// Features a toolchain may have, as probed by ToolchainRegistry
+#define TOOLCHAIN_JSON_DIAGNOSTICS "json-diagnostics"
+#define TOOLCHAIN_PCH "pch"
+#define TOOLCHAIN_LLD "lld"
+#define TOOLCHAIN_GOLD "gold"
+#define TOOLCHAIN_TIME_REPORT "time-report"
+#define TOOLCHAIN_TIME_TRACE "time-trace"
+
+// Project setting. Name or path of the toolchain to use instead of the system gcc.
+#define TOOLCHAIN_KEY "TOOLCHAIN"
+
+struct Toolchain
+{
+	Toolchain();
+
+	//! File name of the driver, e.g. "gcc-12" or "arm-linux-gnueabi-gcc"
+	QString name;
+	QString path;
+	//! "gcc" or "clang"
+	QString family;
+	QString version;
+	int majorVersion;
+	//! Output of -dumpmachine
+	QString machine;
+	//! Directory name under targets/ the toolchain came with. Empty for host toolchains.
+	QString target;
+	QStringList features;
+
+	const bool hasFeature(const QString& feature) const;
+	//! A toolchain that answered --version and -dumpmachine
+	const bool isUsable() const;
+};
+
+/*!
+ * Knows which C compilers are installed: gcc and clang on the host and any
+ * cross toolchains shipped with a target. Probing a compiler runs it a few
+ * times, so results are cached on disk and only redone when the binary
+ * changes (keyed by its resolved path, size and mtime).
+ */
+class ToolchainRegistry : public Singleton<ToolchainRegistry>
+{
+public:
+	ToolchainRegistry();
+
+	//! Finds and probes toolchains. Only the first call does any work. Thread-safe.
+	void discover();
+
+	QList<Toolchain> toolchains();
+
+	/*!
+	 * Toolchain for a target: the one that came with the target, or else the
+	 * host's plain "gcc" driver. gcc drivers win over clang, and the choice
+	 * doesn't depend on timing, so it is the same on every run.
+	 * \param preferred Name or path from the TOOLCHAIN setting, used if it matches
+	 */
+	Toolchain toolchain(const QString& target, const QString& preferred = QString());
+
+	//! Family, version and machine of the compiler at path, without probing its features or caching
+	static Toolchain identify(const QString& path);
+	//! What is used when nothing usable was found
+	static Toolchain fallback();
+	static QString cachePath();
+
+private:
+	QStringList hostCandidates() const;
+	QList<QPair<QString, QString> > targetCandidates() const;
+
+	//! Uses the cached probe when the binary hasn't changed since
+	Toolchain probe(const QString& path, const QString& target, QSettings* cache);
+	static QString run(const QString& path, const QStringList& args, bool* ok = 0);
+
+	QList<Toolchain> m_toolchains;
+	bool m_discovered;
+	QMutex m_mutex;
+};
+
+#endif
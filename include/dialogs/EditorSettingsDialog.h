@@ -22,28 +22,11 @@
 #define __EDITORSETTINGSDIALOG_H__
 
 #include "ui_EditorSettingsDialog.h"
+#include "EditorSettings.h"
 
 #include <QDialog>
 #include <QObject>
 
-#define EDITOR "Editor"
-#define FONT "font"
-#define ENABLED "enabled"
-#define FONT_SIZE "fontsize"
-#define AUTO_COMPLETION "autocompletion"
-#define API_SOURCE "apisource"
-#define DOC_SOURCE "docsource"
-#define THRESHOLD "threshold"
-#define STYLE "style"
-#define MAINTAIN "Maintain"
-#define INTELLIGENT "Intelligent"
-#define CALL_TIPS "calltips"
-#define LINE_NUMBERS "linenumbers"
-#define WIDTH "width"
-#define AUTO_INDENT "autoindent"
-#define BRACE_MATCHING "bracematching"
-#define DEBUGGER_ENABLED "debugger_enabled"
-
 class EditorSettingsDialog : public QDialog, private Ui::EditorSettingsDialog
 {
 Q_OBJECT
@@ -0,0 +1,53 @@
+#ifndef _LEXERAPIS_H_
+#define _LEXERAPIS_H_
+
+#include "Singleton.h"
+
+#include <QObject>
+#include <QMap>
+#include <QString>
+
+class QsciAPIs;
+
+namespace Lexer
+{
+	struct LexerBase;
+	
+	/*!
+	 * Auto-completion APIs, prepared once per kind of lexer and API file and
+	 * shared by every editor that uses them. Preparing a large API file takes
+	 * seconds, so it happens on QsciAPIs' worker thread, and the prepared form
+	 * is cached on disk keyed by a hash of the file. Editors opened before
+	 * preparation finishes get completions as soon as it does.
+	 */
+	class APIs : public QObject, public Singleton<APIs>
+	{
+	Q_OBJECT
+	public:
+		APIs();
+		~APIs();
+		
+		//! Makes lexer complete from the APIs in file
+		void attach(LexerBase* lexer, const QString& file);
+		
+		static QString cacheDirectory();
+		
+	private slots:
+		void preparationFinished();
+		
+	private:
+		struct Entry
+		{
+			//! Lexer the shared QsciAPIs belongs to. Not shown in any editor.
+			LexerBase* owner;
+			QsciAPIs* apis;
+			QString cachePath;
+		};
+		
+		Entry load(LexerBase* lexer, const QString& file);
+		
+		QMap<QString, Entry> m_entries;
+	};
+}
+
+#endif
@@ -45,15 +45,15 @@ namespace Lexer
 
 	struct LexerBase
 	{
-		LexerBase(QsciLexer* lexer, const Constructor* constructor) : m_lexer(lexer), m_constructor(constructor), m_apis(lexer) {}
+		LexerBase(QsciLexer* lexer, const Constructor* constructor) : m_lexer(lexer), m_constructor(constructor) {}
 		const Constructor* constructor() const { return m_constructor; }
 		
-		void setAPIFile(const QString& apis) { if(m_apis.load(apis)) m_apis.prepare(); }
+		//! APIs are prepared in the background and shared with other lexers (see APIs)
+		void setAPIFile(const QString& apis);
 		QsciLexer* lexer() const { return m_lexer; }
 	private:
 		QsciLexer* m_lexer;
 		const Constructor* m_constructor;
-		QsciAPIs m_apis;
 	};
 
 	class Factory : public Singleton<Factory>
@@ -68,14 +68,34 @@ namespace Lexer
 	
 		void registerLexerConstructor(Constructor* c, const QStringList& exts);
 		
+		/*!
+		 * Editors showing the same language with the same APIs and auto-indent
+		 * style share one lexer, and with it its styles. Give it back with
+		 * release() when done.
+		 */
+		LexerBase* acquire(const Constructor* constructor, const QString& apis, int autoIndentStyle);
+		//! Deletes a lexer once the last editor using it has released it
+		void release(LexerBase* lexer);
+		
 		static void setAPIsForLexer(LexerBase* lexer, const QString& apis);
 		static bool isLexerFromConstructor(LexerBase* lexer, Constructor* constructor);
 	
+		//! Also restyles every acquired lexer, unless font is already in use
 		void setFont(const QFont& font);
 		QFont font() const;
 	private:
+		struct Acquired
+		{
+			//! Key in m_shared
+			QString key;
+			QString apis;
+			int refs;
+		};
+		
 		QFont m_font;
 		QMap<QString, Constructor*> m_constructors;
+		QMap<QString, LexerBase*> m_shared;
+		QMap<LexerBase*, Acquired> m_acquired;
 	};
 }
 
@@ -9,6 +9,9 @@
 #define DEFAULT_WARNING_KEY "Warnings"
 #define DEFAULT_LINKER_KEY "Linker"
 
+class QListWidget;
+class QListWidgetItem;
+
 class ErrorWidget : public QWidget, private Ui::ErrorWidget
 {
 Q_OBJECT
@@ -18,9 +21,15 @@ public:
 	void setCompileResult(const WorkingUnit* unit, const CompileResult& results);
 public slots:
 	void workingUnitChanged(const WorkingUnit* current);
+signals:
+	//! Emitted when the user activates a diagnostic that has a location. line and column are 1-based.
+	void diagnosticActivated(const QString& file, int line, int column);
 private slots:
 	void on_ui_viewMode_currentIndexChanged(int index);
+	void itemActivated(QListWidgetItem* item);
 private:
+	QListWidget* createList();
+	QListWidget* createDiagnosticList(const DiagnosticList& diagnostics, Diagnostic::Severity severity);
 	void setCategorized();
 	void setRaw();
 	const WorkingUnit* m_current;
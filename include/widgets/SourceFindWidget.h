@@ -25,6 +25,7 @@
 #include "ui_SourceFindWidget.h"
 
 class SourceFile;
+class FindIndex;
 
 class SourceFindWidget : public QWidget, public Ui::SourceFindWidget
 {
@@ -40,6 +41,9 @@ public:
 public slots:
 	void show();
 	
+protected:
+	void hideEvent(QHideEvent* event);
+	
 private slots:
 	void on_ui_next_clicked();
 	void on_ui_find_textChanged(const QString& text);
@@ -48,7 +52,10 @@ private slots:
 	void on_ui_replaceAll_clicked();
 	
 private:
+	void updateQuery();
+	
 	SourceFile* m_sourceFile;
+	FindIndex* m_index;
 	
 	bool m_findModified;
 };
@@ -0,0 +1,268 @@
+#include "BatchBuild.h"
+
+#include "Compilation.h"
+#include "CommandChain.h"
+#include "Project.h"
+#include "ArchiveWriter.h"
+#include "Temporary.h"
+#include "BuildProfile.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFile>
+#include <QDebug>
+
+#include <cstdio>
+#include <cstdlib>
+
+bool BatchBuild::s_verbose = false;
+
+namespace
+{
+	QByteArray jsonString(const QString& str)
+	{
+		QByteArray ret = "\"";
+		foreach(const QChar& c, str) {
+			if(c == '"') ret += "\\\"";
+			else if(c == '\\') ret += "\\\\";
+			else if(c == '\n') ret += "\\n";
+			else if(c == '\t') ret += "\\t";
+			else if(c.unicode() < 0x20) ret += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0')).toAscii();
+			else ret += QString(c).toUtf8();
+		}
+		return ret + "\"";
+	}
+
+	QByteArray jsonStringList(const QStringList& list)
+	{
+		QByteArray ret;
+		foreach(const QString& str, list) {
+			if(!ret.isEmpty()) ret += ",";
+			ret += jsonString(str);
+		}
+		return "[" + ret + "]";
+	}
+}
+
+class BatchBuild::Task : public QRunnable
+{
+public:
+	Task(BatchBuild* build, int index) : m_build(build), m_index(index) { setAutoDelete(false); }
+
+	virtual void run() { m_build->build(m_index, &result); }
+
+	Result result;
+private:
+	BatchBuild* m_build;
+	int m_index;
+};
+
+BatchBuild::Result::Result()
+	: success(false), msecs(0)
+{
+
+}
+
+BatchBuild::BatchBuild()
+	: m_jobs(QThread::idealThreadCount()), m_parallelProjects(0), m_timeout(0), m_profile(false), m_pool(0)
+{
+	if(m_jobs < 1) m_jobs = 1;
+}
+
+BatchBuild::~BatchBuild()
+{
+	delete m_pool;
+}
+
+const bool BatchBuild::parseArguments(const QStringList& args)
+{
+	for(int i = 0; i < args.size(); ++i) {
+		const QString& arg = args[i];
+		const bool hasValue = i + 1 < args.size();
+		bool ok = true;
+		if(arg == "--jobs" && hasValue) m_jobs = args[++i].toInt(&ok);
+		else if(arg == "--projects" && hasValue) m_parallelProjects = args[++i].toInt(&ok);
+		else if(arg == "--timeout" && hasValue) m_timeout = args[++i].toLongLong(&ok);
+		else if(arg == "--results" && hasValue) m_resultsPath = QFileInfo(args[++i]).absoluteFilePath();
+		else if(arg == "--profile") m_profile = true;
+		else if(arg == "--verbose") s_verbose = true;
+		else if(arg.startsWith("--")) {
+			qWarning() << "Unknown or incomplete option" << arg;
+			return false;
+		} else m_projects << QFileInfo(arg).absoluteFilePath();
+
+		if(!ok || m_jobs < 1 || m_parallelProjects < 0 || m_timeout < 0) {
+			qWarning() << "Invalid value for" << arg;
+			return false;
+		}
+	}
+	return !m_projects.isEmpty();
+}
+
+QString BatchBuild::usage()
+{
+	return "Usage: KISS --build [options] project.kissproj...\n"
+		"  --jobs N        Compiler processes to run at once, across all projects (default: one per core)\n"
+		"  --projects N    Projects to build at once (default: same as --jobs)\n"
+		"  --timeout MS    Give up on a project after MS milliseconds\n"
+		"  --results FILE  Write the JSON results to FILE instead of standard output\n"
+		"  --profile       Profile every build (see PROFILE_BUILD)\n"
+		"  --verbose       Also log debug messages\n";
+}
+
+int BatchBuild::exec()
+{
+	qInstallMsgHandler(messageHandler);
+
+	// Probe compilers up front rather than in whichever build gets there first
+	ToolchainRegistry::ref().discover();
+
+	delete m_pool;
+	m_pool = new JobPool(m_jobs);
+
+	// Projects spend part of their time linking or waiting on a precompiled
+	// header, so by default there are as many in flight as there are jobs
+	QThreadPool threads;
+	threads.setMaxThreadCount(m_parallelProjects > 0 ? m_parallelProjects : m_jobs);
+
+	QElapsedTimer timer;
+	timer.start();
+	QList<Task*> tasks;
+	for(int i = 0; i < m_projects.size(); ++i) {
+		Task* task = new Task(this, i);
+		tasks << task;
+		threads.start(task);
+	}
+	threads.waitForDone();
+
+	QList<Result> results;
+	int succeeded = 0;
+	foreach(Task* task, tasks) {
+		results << task->result;
+		if(task->result.success) ++succeeded;
+		delete task;
+	}
+	const qint64 elapsed = timer.elapsed();
+
+	const QByteArray json = resultsJson(results, elapsed);
+	if(m_resultsPath.isEmpty()) {
+		fwrite(json.constData(), 1, json.size(), stdout);
+		fflush(stdout);
+	} else {
+		QFile file(m_resultsPath);
+		if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			qCritical() << "Unable to write results to" << m_resultsPath;
+			return BATCH_BUILD_FAILED;
+		}
+		file.write(json);
+	}
+
+	fprintf(stderr, "Built %d of %d projects in %lld ms with %d jobs\n", succeeded, results.size(),
+		(long long)elapsed, m_jobs);
+	return succeeded == results.size() ? BATCH_BUILD_SUCCEEDED : BATCH_BUILD_FAILED;
+}
+
+void BatchBuild::build(int index, Result* result)
+{
+	QElapsedTimer timer;
+	timer.start();
+	result->project = m_projects[index];
+
+	Project* project = Project::load(result->project);
+	if(!project) {
+		result->error = "Unable to open project";
+		return;
+	}
+
+	// Submissions tend to share a name. Their sources and outputs must not.
+	result->name = QString("%1-%2").arg(project->name()).arg(index);
+	QMap<QString, QString> settings = project->settings();
+	if(m_timeout > 0) settings[COMPILE_TIMEOUT_KEY] = QString::number(m_timeout);
+
+	{
+		ArchiveWriter writer(project->archive(), Temporary::subdir("build_" + result->name));
+		Compilation compilation(CompilerManager::ref().compilers(), settings);
+		compilation.setName(result->name);
+		compilation.setJobPool(m_pool);
+		if(m_profile) compilation.setProfiling(true);
+		compilation.addFiles(writer.files());
+
+		result->success = compilation.start();
+		result->compileResult = compilation.results();
+		result->outputs = compilation.compileResults();
+		if(compilation.profile()) result->trace = compilation.profile()->tracePath();
+	}
+	delete project;
+
+	result->msecs = timer.elapsed();
+	qDebug() << "Built" << result->project << (result->success ? "successfully" : "with errors") << "in" << result->msecs << "ms";
+}
+
+QByteArray BatchBuild::resultsJson(const QList<Result>& results, qint64 msecs) const
+{
+	QByteArray ret = "{\n\"msecs\":" + QByteArray::number(msecs) + ",\n\"jobs\":" + QByteArray::number(m_jobs)
+		+ ",\n\"projects\":[\n";
+	for(int i = 0; i < results.size(); ++i) {
+		const Result& result = results[i];
+		const CompileResult& compileResult = result.compileResult;
+
+		QByteArray diagnostics;
+		int errors = 0;
+		int warnings = 0;
+		foreach(const Diagnostic& diag, compileResult.diagnostics()) {
+			if(diag.severity == Diagnostic::Error) ++errors;
+			else if(diag.severity == Diagnostic::Warning) ++warnings;
+			if(!diagnostics.isEmpty()) diagnostics += ",";
+			diagnostics += "{\"file\":" + jsonString(diag.file)
+				+ ",\"line\":" + QByteArray::number(diag.line)
+				+ ",\"column\":" + QByteArray::number(diag.column)
+				+ ",\"severity\":" + jsonString(Diagnostic::severityName(diag.severity))
+				+ ",\"message\":" + jsonString(diag.message) + "}";
+		}
+
+		QByteArray timings;
+		QMap<QString, qint64>::const_iterator it = compileResult.timings().constBegin();
+		for(; it != compileResult.timings().constEnd(); ++it) {
+			if(!timings.isEmpty()) timings += ",";
+			timings += jsonString(it.key()) + ":" + QByteArray::number(it.value());
+		}
+
+		ret += "{\"project\":" + jsonString(result.project)
+			+ ",\"name\":" + jsonString(result.name)
+			+ ",\"success\":" + (result.success ? "true" : "false")
+			+ ",\"cancelled\":" + (compileResult.cancelled() ? "true" : "false")
+			+ ",\"msecs\":" + QByteArray::number(result.msecs)
+			+ ",\"errors\":" + QByteArray::number(errors)
+			+ ",\"warnings\":" + QByteArray::number(warnings)
+			+ ",\"outputs\":" + jsonStringList(result.outputs)
+			+ ",\"timings\":{" + timings + "}"
+			+ ",\"diagnostics\":[" + diagnostics + "]";
+		if(!result.error.isEmpty()) ret += ",\"error\":" + jsonString(result.error);
+		if(!result.trace.isEmpty()) ret += ",\"trace\":" + jsonString(result.trace);
+		ret += "}";
+		if(i + 1 < results.size()) ret += ",";
+		ret += "\n";
+	}
+	return ret + "]\n}\n";
+}
+
+void BatchBuild::messageHandler(QtMsgType type, const char* msg)
+{
+	// Standard output carries the results, so everything else goes to stderr
+	switch(type) {
+	case QtDebugMsg:
+		if(s_verbose) fprintf(stderr, "%s\n", msg);
+		break;
+	case QtWarningMsg:
+	case QtCriticalMsg:
+		fprintf(stderr, "%s\n", msg);
+		break;
+	case QtFatalMsg:
+		fprintf(stderr, "%s\n", msg);
+		abort();
+	}
+}
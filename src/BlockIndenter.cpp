@@ -0,0 +1,267 @@
+#include "BlockIndenter.h"
+
+#include <Qsci/qsciscintilla.h>
+#include <Qsci/qscilexer.h>
+
+#include <climits>
+
+// m_dirty when every depth is current
+#define DEPTH_CURRENT INT_MAX
+// Depth of a line that was inserted and not yet scanned. Never matches a real one.
+#define DEPTH_UNKNOWN INT_MIN
+// Lines lexed and read from Scintilla at a time while catching up
+#define SCAN_CHUNK_LINES 256
+
+namespace
+{
+	bool isIndentedBy(const QByteArray& styled, int base, int start, int end, int tabs)
+	{
+		if(end - start != tabs) return false;
+		for(int pos = start; pos < end; ++pos) if(styled[2 * (pos - base)] != '\t') return false;
+		return true;
+	}
+}
+
+BlockIndenter::BlockIndenter(QsciScintilla* editor, QObject* parent)
+	: QObject(parent),
+	m_editor(editor),
+	m_blockStart(0),
+	m_blockEnd(0),
+	m_blockStartStyle(-1),
+	m_blockEndStyle(-1),
+	m_defaultStyle(-1),
+	m_dirty(DEPTH_CURRENT),
+	m_dirtyEnd(-1)
+{
+	m_depth.fill(DEPTH_UNKNOWN, qMax(m_editor->lines(), 1));
+	m_depth[0] = 0;
+	invalidate(0, m_depth.size() - 1);
+
+	connect(m_editor, SIGNAL(SCN_MODIFIED(int, int, const char*, int, int, int, int, int, int, int)),
+		SLOT(modified(int, int, const char*, int, int, int, int, int, int, int)));
+}
+
+int BlockIndenter::indentAll()
+{
+	if(!readLexer()) return 0;
+
+	// Scintilla only styles what has been shown so far
+	const int length = m_editor->SendScintilla(QsciScintilla::SCI_GETLENGTH);
+	m_editor->SendScintilla(QsciScintilla::SCI_COLOURISE, 0, -1);
+	const QByteArray styled = styledText(0, length);
+
+	const int lines = m_editor->SendScintilla(QsciScintilla::SCI_GETLINECOUNT);
+	QVector<int> depth(lines, 0);
+	QList<LineIndent> changed;
+	for(int line = 0; line < lines; ++line) {
+		const int start = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line);
+		const int end = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line + 1);
+		const LineScan scan = scanLine(styled, 0, start, end);
+		if(line + 1 < lines) depth[line + 1] = depth[line] + scan.opened - scan.closed;
+		// The empty line after a trailing newline is left alone
+		if(start == end) continue;
+
+		const int nextStyle = end < length ? (uchar)styled[2 * end + 1] : -1;
+		const int tabs = indentFor(scan, depth[line], nextStyle);
+		if(tabs < 0 || isIndentedBy(styled, 0, start, scan.indentEnd, tabs)) continue;
+
+		LineIndent indent;
+		indent.start = start;
+		indent.indentEnd = scan.indentEnd;
+		indent.level = tabs;
+		changed << indent;
+	}
+
+	m_depth = depth;
+	m_dirty = DEPTH_CURRENT;
+	m_dirtyEnd = -1;
+	// Reindenting doesn't change any depths, so the rescan this triggers stops right away
+	return apply(changed);
+}
+
+const bool BlockIndenter::indentLine(int line)
+{
+	if(!readLexer() || line < 0 || line >= m_depth.size()) return false;
+	updateDepth(line);
+
+	const int length = m_editor->SendScintilla(QsciScintilla::SCI_GETLENGTH);
+	const int start = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line);
+	const int end = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line + 1);
+	// The first character of the next line decides whether this one continues a comment
+	const int styledEnd = qMin(end + 1, length);
+	m_editor->SendScintilla(QsciScintilla::SCI_COLOURISE, start, styledEnd);
+	const QByteArray styled = styledText(start, styledEnd);
+
+	const LineScan scan = scanLine(styled, start, start, end);
+	const int nextStyle = end < length ? (uchar)styled[2 * (end - start) + 1] : -1;
+	const int tabs = indentFor(scan, m_depth[line], nextStyle);
+	if(tabs < 0 || isIndentedBy(styled, start, start, scan.indentEnd, tabs)) return false;
+
+	const int caret = m_editor->SendScintilla(QsciScintilla::SCI_GETCURRENTPOS);
+	LineIndent indent;
+	indent.start = start;
+	indent.indentEnd = scan.indentEnd;
+	indent.level = tabs;
+	apply(QList<LineIndent>() << indent);
+
+	// Text inserted right at the caret goes after it, which would leave it at the start of the line
+	if(caret >= start && caret <= scan.indentEnd) m_editor->SendScintilla(QsciScintilla::SCI_GOTOPOS, start + tabs);
+	return true;
+}
+
+int BlockIndenter::level(int line)
+{
+	if(!readLexer() || line < 0 || line >= m_depth.size()) return 0;
+	updateDepth(line);
+
+	const int start = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line);
+	const int end = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, line + 1);
+	m_editor->SendScintilla(QsciScintilla::SCI_COLOURISE, start, end);
+	const LineScan scan = scanLine(styledText(start, end), start, start, end);
+	return qMax(m_depth[line] - qMax(scan.closed - scan.opened, 0), 0);
+}
+
+void BlockIndenter::modified(int position, int modificationType, const char*, int length, int linesAdded,
+	int, int, int, int, int)
+{
+	if(!(modificationType & (QsciScintilla::SC_MOD_INSERTTEXT | QsciScintilla::SC_MOD_DELETETEXT
+		| QsciScintilla::SC_MOD_CHANGESTYLE))) return;
+
+	const int first = m_editor->SendScintilla(QsciScintilla::SCI_LINEFROMPOSITION, position);
+	if(linesAdded > 0) m_depth.insert(first + 1, linesAdded, DEPTH_UNKNOWN);
+	else if(linesAdded < 0) m_depth.remove(first + 1, qMin(-linesAdded, m_depth.size() - first - 1));
+	if(linesAdded && m_dirtyEnd > first) m_dirtyEnd = qMax(first, m_dirtyEnd + linesAdded);
+
+	// Restyling (a comment being opened, say) can reach far beyond the edit itself
+	int last = first + qMax(linesAdded, 0);
+	if(modificationType & QsciScintilla::SC_MOD_CHANGESTYLE) {
+		last = m_editor->SendScintilla(QsciScintilla::SCI_LINEFROMPOSITION, position + length);
+	}
+	invalidate(first, last);
+}
+
+const bool BlockIndenter::readLexer()
+{
+	QsciLexer* lexer = m_editor->lexer();
+	if(!lexer) return false;
+
+	int blockStartStyle = -1;
+	int blockEndStyle = -1;
+	const char* blockStart = lexer->blockStart(&blockStartStyle);
+	const char* blockEnd = lexer->blockEnd(&blockEndStyle);
+	if(!blockStart || !blockEnd || !*blockStart || !*blockEnd) return false;
+	m_defaultStyle = lexer->defaultStyle();
+
+	if(*blockStart == m_blockStart && *blockEnd == m_blockEnd
+		&& blockStartStyle == m_blockStartStyle && blockEndStyle == m_blockEndStyle) return true;
+
+	// A different language. Nothing scanned so far counts.
+	m_blockStart = *blockStart;
+	m_blockEnd = *blockEnd;
+	m_blockStartStyle = blockStartStyle;
+	m_blockEndStyle = blockEndStyle;
+	invalidate(0, m_depth.size() - 1);
+	return true;
+}
+
+BlockIndenter::LineScan BlockIndenter::scanLine(const QByteArray& styled, int base, int start, int end) const
+{
+	LineScan ret;
+	ret.opened = 0;
+	ret.closed = 0;
+	ret.indentEnd = -1;
+	ret.lastStyle = -1;
+
+	const char* text = styled.constData();
+	for(int pos = start; pos < end; ++pos) {
+		const char c = text[2 * (pos - base)];
+		const int style = (uchar)text[2 * (pos - base) + 1];
+		if(ret.indentEnd < 0 && c != ' ' && c != '\t') ret.indentEnd = pos;
+		if(c == m_blockStart && style == m_blockStartStyle) ++ret.opened;
+		else if(c == m_blockEnd && style == m_blockEndStyle) ++ret.closed;
+		ret.lastStyle = style;
+	}
+	if(ret.indentEnd < 0) ret.indentEnd = end;
+	return ret;
+}
+
+int BlockIndenter::indentFor(const LineScan& scan, int depth, int nextStyle) const
+{
+	// A line closing more blocks than it opens is outdented itself
+	int level = depth;
+	if(scan.closed > scan.opened) level -= scan.closed - scan.opened;
+
+	// Lines continuing a comment or string keep their indentation, unless inside a block.
+	// The last line has nothing after it, which counts as a change of style.
+	if(scan.lastStyle == m_defaultStyle || scan.lastStyle != nextStyle || level) return qMax(level, 0);
+	return -1;
+}
+
+QByteArray BlockIndenter::styledText(int start, int end) const
+{
+	// Scintilla writes two extra NULs after the pairs
+	QByteArray ret(2 * (end - start) + 2, '\0');
+	m_editor->SendScintilla(QsciScintilla::SCI_GETSTYLEDTEXT, start, end, ret.data());
+	ret.chop(2);
+	return ret;
+}
+
+int BlockIndenter::apply(const QList<LineIndent>& lines)
+{
+	if(lines.isEmpty()) return 0;
+
+	// Bottom up, so the positions of lines still to be changed stay valid
+	m_editor->SendScintilla(QsciScintilla::SCI_BEGINUNDOACTION);
+	for(int i = lines.size() - 1; i >= 0; --i) {
+		const LineIndent& line = lines[i];
+		const QByteArray indent(line.level, '\t');
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETSTART, line.start);
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETEND, line.indentEnd);
+		m_editor->SendScintilla(QsciScintilla::SCI_REPLACETARGET, indent.size(), indent.constData());
+	}
+	m_editor->SendScintilla(QsciScintilla::SCI_ENDUNDOACTION);
+	return lines.size();
+}
+
+void BlockIndenter::updateDepth(int line)
+{
+	const int lines = m_depth.size();
+	while(m_dirty < line && m_dirty < lines - 1) {
+		const int chunkStart = m_dirty;
+		const int chunkEnd = qMin(chunkStart + SCAN_CHUNK_LINES, lines - 1);
+		const int start = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, chunkStart);
+		const int end = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, chunkEnd);
+		// Lexing may restyle lines further down, which extends m_dirtyEnd through modified()
+		m_editor->SendScintilla(QsciScintilla::SCI_COLOURISE, start, end);
+		const QByteArray styled = styledText(start, end);
+
+		int lineStart = start;
+		for(int i = chunkStart; i < chunkEnd; ++i) {
+			const int next = m_editor->SendScintilla(QsciScintilla::SCI_POSITIONFROMLINE, i + 1);
+			const LineScan scan = scanLine(styled, start, lineStart, next);
+			const int depth = m_depth[i] + scan.opened - scan.closed;
+			const bool converged = i >= m_dirtyEnd && m_depth[i + 1] == depth;
+			m_depth[i + 1] = depth;
+			lineStart = next;
+
+			// Everything after this line is as it was, and so are their depths
+			if(converged) {
+				m_dirty = DEPTH_CURRENT;
+				m_dirtyEnd = -1;
+				return;
+			}
+			m_dirty = i + 1;
+			if(m_dirty >= line) break;
+		}
+	}
+	if(m_dirty >= lines - 1) {
+		m_dirty = DEPTH_CURRENT;
+		m_dirtyEnd = -1;
+	}
+}
+
+void BlockIndenter::invalidate(int first, int last)
+{
+	m_dirty = qMin(m_dirty, first);
+	m_dirtyEnd = qMax(m_dirtyEnd, last);
+}
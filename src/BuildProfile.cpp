@@ -0,0 +1,461 @@
+#include "BuildProfile.h"
+
+#include "Toolchain.h"
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSet>
+#include <QScriptEngine>
+#include <QScriptValue>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+
+#define INCLUDE_GUARDS_HEADER "Multiple include guards may be useful for:"
+
+namespace
+{
+	bool byDurationDescending(const ProfiledUnit& a, const ProfiledUnit& b)
+	{
+		return a.duration() > b.duration();
+	}
+
+	bool byStart(const ProfiledUnit& a, const ProfiledUnit& b)
+	{
+		return a.start < b.start;
+	}
+
+	bool byTime(const HeaderCost& a, const HeaderCost& b)
+	{
+		return a.msecs > b.msecs;
+	}
+
+	bool byBytes(const HeaderCost& a, const HeaderCost& b)
+	{
+		return a.inclusiveBytes > b.inclusiveBytes;
+	}
+
+	QByteArray jsonString(const QString& str)
+	{
+		QByteArray ret = "\"";
+		foreach(const QChar& c, str) {
+			if(c == '"') ret += "\\\"";
+			else if(c == '\\') ret += "\\\\";
+			else if(c == '\n') ret += "\\n";
+			else if(c == '\t') ret += "\\t";
+			else if(c.unicode() < 0x20) ret += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0')).toAscii();
+			else ret += QString(c).toUtf8();
+		}
+		return ret + "\"";
+	}
+
+	//! Lines from gcc's -ftime-report that aren't part of its table
+	bool isTimeReportTrailer(const QString& line)
+	{
+		return line.startsWith("Extra diagnostic checks enabled")
+			|| line.startsWith("Configure with --disable-checking");
+	}
+}
+
+ProfiledUnit::ProfiledUnit()
+	: start(-1), end(-1), success(false)
+{
+
+}
+
+qint64 ProfiledUnit::duration() const
+{
+	return start < 0 || end < start ? 0 : end - start;
+}
+
+HeaderCost::HeaderCost()
+	: units(0), inclusiveBytes(0), msecs(0.0)
+{
+
+}
+
+BuildProfile::BuildProfile()
+{
+	m_clock.start();
+}
+
+qint64 BuildProfile::elapsed() const
+{
+	return m_clock.nsecsElapsed() / 1000;
+}
+
+QStringList BuildProfile::flags(const Toolchain& toolchain)
+{
+	// -H lists every header as it is opened. It's the only per-header detail gcc gives.
+	QStringList ret;
+	if(toolchain.hasFeature(TOOLCHAIN_TIME_TRACE)) ret << "-ftime-trace";
+	else if(toolchain.hasFeature(TOOLCHAIN_TIME_REPORT)) ret << "-ftime-report";
+	return ret << "-H";
+}
+
+void BuildProfile::addUnit(const ProfiledUnit& unit)
+{
+	QMutexLocker locker(&m_mutex);
+	m_units.append(unit);
+}
+
+QList<ProfiledUnit> BuildProfile::units() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_units;
+}
+
+QByteArray BuildProfile::takeReport(const QByteArray& err, ProfiledUnit* unit)
+{
+	QRegExp include("^(\\.+|!|x) (\\S.*)$");
+	// gcc 9 and later: "name : usr ( n%) sys ( n%) wall ( n%) GGC". TOTAL has no percentages.
+	QRegExp phase("^\\s*(\\S.*\\S)\\s*:\\s*[0-9.]+(?:\\s*\\(\\s*\\d+%\\))?\\s+[0-9.]+(?:\\s*\\(\\s*\\d+%\\))?\\s+([0-9.]+)");
+	// Older gcc: "name : n ( n%) usr n ( n%) sys n ( n%) wall"
+	QRegExp oldPhase("^\\s*(\\S.*\\S)\\s*:.*\\s([0-9.]+)\\s*\\(\\s*\\d+%\\)\\s*wall");
+
+	QByteArray ret;
+	bool inTimeReport = false;
+	bool inGuards = false;
+	int start = 0;
+	while(start < err.size()) {
+		int eol = err.indexOf('\n', start);
+		if(eol < 0) eol = err.size();
+		const QByteArray rawLine = err.mid(start, eol - start);
+		start = eol + 1;
+		const QString line = QString::fromLocal8Bit(rawLine);
+
+		if(inGuards) {
+			// One path per line until something that looks like a diagnostic
+			if(!line.isEmpty() && !line.contains(": ")) continue;
+			inGuards = false;
+		}
+
+		if(inTimeReport) {
+			QString name;
+			double wall = -1.0;
+			if(phase.indexIn(line) >= 0) {
+				name = phase.cap(1);
+				wall = phase.cap(2).toDouble();
+			} else if(oldPhase.indexIn(line) >= 0) {
+				name = oldPhase.cap(1);
+				wall = oldPhase.cap(2).toDouble();
+			}
+			if(name.startsWith("phase ")) unit->phases[name.mid(6)] += wall * 1000.0;
+			else if(name == "TOTAL") {
+				unit->phases["total"] += wall * 1000.0;
+				inTimeReport = false;
+			}
+			continue;
+		}
+
+		if(line.startsWith("Time variable") || line.startsWith("Execution times")) {
+			inTimeReport = true;
+			continue;
+		}
+		if(isTimeReportTrailer(line)) continue;
+		if(line == INCLUDE_GUARDS_HEADER) {
+			inGuards = true;
+			continue;
+		}
+
+		if(include.exactMatch(line)) {
+			const QString marker = include.cap(1);
+			// '!' and 'x' mark precompiled headers that were and weren't usable
+			if(marker[0] == '.' || include.cap(2).endsWith(".gch")) {
+				unit->includes.append(qMakePair(include.cap(2), marker[0] == '.' ? marker.size() : 1));
+				continue;
+			}
+		}
+
+		ret += rawLine;
+		if(eol < err.size()) ret += '\n';
+	}
+	return ret;
+}
+
+bool BuildProfile::readTimeTrace(const QString& path, ProfiledUnit* unit)
+{
+	QFile file(path);
+	if(!file.open(QIODevice::ReadOnly)) return false;
+
+	QScriptEngine engine;
+	QScriptValue parse = engine.globalObject().property("JSON").property("parse");
+	const QScriptValue trace = parse.call(QScriptValue(), QScriptValueList() << QString::fromUtf8(file.readAll()));
+	if(engine.hasUncaughtException()) {
+		qWarning() << "Unable to parse time trace" << path << engine.uncaughtException().toString();
+		return false;
+	}
+
+	const QScriptValue events = trace.property("traceEvents");
+	const int length = events.property("length").toInt32();
+	for(int i = 0; i < length; ++i) {
+		const QScriptValue event = events.property(i);
+		const QString name = event.property("name").toString();
+		const double msecs = event.property("dur").toNumber() / 1000.0;
+		// Nested Source events overlap, so each header's time includes its own includes
+		if(name == "Source") unit->headerMsecs[event.property("args").property("detail").toString()] += msecs;
+		else if(name.startsWith("Total ")) unit->phases[name.mid(6)] = msecs;
+	}
+	return true;
+}
+
+QList<ProfiledUnit> BuildProfile::slowestUnits(int count) const
+{
+	QList<ProfiledUnit> ret = units();
+	std::stable_sort(ret.begin(), ret.end(), byDurationDescending);
+	return ret.mid(0, count);
+}
+
+QList<HeaderCost> BuildProfile::expensiveHeaders(int count) const
+{
+	QMap<QString, HeaderCost> costs;
+	QMap<QString, qint64> sizes;
+	bool timed = false;
+
+	foreach(const ProfiledUnit& unit, units()) {
+		QSet<QString> seen;
+
+		// Each header is charged its own size and that of everything it includes.
+		// open holds the headers still being read when an entry is reached.
+		QList<QPair<QString, int> > open;
+		for(int i = 0; i < unit.includes.size(); ++i) {
+			const QString& path = unit.includes[i].first;
+			const int depth = unit.includes[i].second;
+			while(!open.isEmpty() && open.last().second >= depth) open.removeLast();
+
+			QMap<QString, qint64>::iterator size = sizes.find(path);
+			if(size == sizes.end()) size = sizes.insert(path, QFileInfo(path).size());
+
+			costs[path].inclusiveBytes += size.value();
+			for(int j = 0; j < open.size(); ++j) costs[open[j].first].inclusiveBytes += size.value();
+			open.append(unit.includes[i]);
+			seen.insert(path);
+		}
+
+		QMap<QString, double>::const_iterator it = unit.headerMsecs.constBegin();
+		for(; it != unit.headerMsecs.constEnd(); ++it) {
+			costs[it.key()].msecs += it.value();
+			seen.insert(it.key());
+			timed = true;
+		}
+
+		foreach(const QString& path, seen) costs[path].units++;
+	}
+
+	QList<HeaderCost> ret;
+	QMap<QString, HeaderCost>::iterator it = costs.begin();
+	for(; it != costs.end(); ++it) {
+		it.value().path = it.key();
+		ret.append(it.value());
+	}
+	std::stable_sort(ret.begin(), ret.end(), timed ? byTime : byBytes);
+	return ret.mid(0, count);
+}
+
+QList<ProfiledUnit> BuildProfile::criticalPath() const
+{
+	const QList<ProfiledUnit> all = units();
+	QList<ProfiledUnit> ret;
+	if(all.isEmpty()) return ret;
+
+	int current = 0;
+	for(int i = 1; i < all.size(); ++i) if(all[i].end > all[current].end) current = i;
+
+	// Whatever finished last before a unit started is what it was waiting on
+	while(current >= 0) {
+		ret.prepend(all[current]);
+		int previous = -1;
+		for(int i = 0; i < all.size(); ++i) {
+			if(all[i].end > all[current].start) continue;
+			if(previous < 0 || all[i].end > all[previous].end) previous = i;
+		}
+		current = previous;
+	}
+	return ret;
+}
+
+QString BuildProfile::report() const
+{
+	const QList<ProfiledUnit> all = units();
+	qint64 first = -1;
+	qint64 last = 0;
+	qint64 busy = 0;
+	foreach(const ProfiledUnit& unit, all) {
+		if(first < 0 || unit.start < first) first = unit.start;
+		last = qMax(last, unit.end);
+		busy += unit.duration();
+	}
+	const qint64 wall = first < 0 ? 0 : last - first;
+
+	QString ret;
+	QTextStream stream(&ret);
+	stream << QObject::tr("%n unit(s) in %1 ms, %2 ms of compiler time (%3x parallel)", 0, all.size())
+		.arg(wall / 1000).arg(busy / 1000).arg(wall ? (double)busy / wall : 0.0, 0, 'f', 1) << "\n\n";
+
+	stream << QObject::tr("Slowest units") << "\n";
+	foreach(const ProfiledUnit& unit, slowestUnits(15)) {
+		QString slowestPhase;
+		double slowestMsecs = 0.0;
+		QMap<QString, double>::const_iterator it = unit.phases.constBegin();
+		for(; it != unit.phases.constEnd(); ++it) {
+			if(it.key() == "total" || it.key() == "ExecuteCompiler" || it.value() <= slowestMsecs) continue;
+			slowestPhase = it.key();
+			slowestMsecs = it.value();
+		}
+		stream << QString("%1 ms  ").arg(unit.duration() / 1000.0, 9, 'f', 1) << unit.name;
+		if(!slowestPhase.isEmpty()) stream << QString("  (%1: %2 ms)").arg(slowestPhase).arg(slowestMsecs, 0, 'f', 1);
+		if(!unit.success) stream << "  " << QObject::tr("failed");
+		stream << "\n";
+	}
+
+	const QList<HeaderCost> headers = expensiveHeaders(20);
+	if(!headers.isEmpty()) {
+		const bool timed = headers[0].msecs > 0.0;
+		stream << "\n" << (timed ? QObject::tr("Most expensive headers (time spent parsing, summed over units)")
+			: QObject::tr("Most expensive headers (bytes parsed because of the header, summed over units)")) << "\n";
+		foreach(const HeaderCost& header, headers) {
+			if(timed) stream << QString("%1 ms  ").arg(header.msecs, 9, 'f', 1);
+			else stream << QString("%1 KB  ").arg(header.inclusiveBytes / 1024, 9);
+			stream << QObject::tr("%n unit(s)", 0, header.units).leftJustified(10) << "  " << header.path << "\n";
+		}
+	}
+
+	const QList<ProfiledUnit> path = criticalPath();
+	if(!path.isEmpty()) {
+		stream << "\n" << QObject::tr("Critical path (%1 ms)").arg((path.last().end - path.first().start) / 1000) << "\n";
+		foreach(const ProfiledUnit& unit, path) {
+			stream << QString("%1 ms +%2 ms  ").arg((unit.start - first) / 1000, 7).arg(unit.duration() / 1000, 6)
+				<< unit.name << "\n";
+		}
+	}
+
+	if(!m_tracePath.isEmpty()) stream << "\n" << QObject::tr("Trace written to %1").arg(m_tracePath) << "\n";
+	stream.flush();
+	return ret;
+}
+
+QByteArray BuildProfile::chromeTrace() const
+{
+	QList<ProfiledUnit> all = units();
+	std::stable_sort(all.begin(), all.end(), byStart);
+
+	// Units that overlap go on separate lanes, like the jobs that ran them
+	QList<qint64> laneEnds;
+	QByteArray events;
+	foreach(const ProfiledUnit& unit, all) {
+		int lane = 0;
+		while(lane < laneEnds.size() && laneEnds[lane] > unit.start) ++lane;
+		if(lane == laneEnds.size()) laneEnds.append(0);
+		laneEnds[lane] = unit.end;
+
+		QByteArray args = "\"success\":" + QByteArray(unit.success ? "true" : "false");
+		QMap<QString, double>::const_iterator it = unit.phases.constBegin();
+		for(; it != unit.phases.constEnd(); ++it) {
+			args += "," + jsonString(it.key() + " (ms)") + ":" + QByteArray::number(it.value(), 'f', 2);
+		}
+
+		if(!events.isEmpty()) events += ",\n";
+		events += "{\"name\":" + jsonString(unit.name)
+			+ ",\"cat\":" + jsonString(unit.category)
+			+ ",\"ph\":\"X\",\"ts\":" + QByteArray::number(unit.start)
+			+ ",\"dur\":" + QByteArray::number(unit.duration())
+			+ ",\"pid\":1,\"tid\":" + QByteArray::number(lane + 1)
+			+ ",\"args\":{" + args + "}}";
+	}
+	return "{\"traceEvents\":[\n" + events + "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+const bool BuildProfile::save(const QString& path)
+{
+	QFile file(path);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Unable to write build profile to" << path;
+		return false;
+	}
+	file.write(chromeTrace());
+	m_tracePath = path;
+	return true;
+}
+
+const QString& BuildProfile::tracePath() const
+{
+	return m_tracePath;
+}
+
+ProfiledSegment::ProfiledSegment(BuildProfile* profile, ChainSegment* segment, const QString& name,
+		const QString& category, const QString& timeTrace)
+	: m_profile(profile), m_segment(segment), m_timeTrace(timeTrace)
+{
+	m_segment->setSession(&m_session);
+	m_unit.name = name;
+	m_unit.category = category;
+}
+
+ProfiledSegment::~ProfiledSegment()
+{
+	delete m_segment;
+}
+
+const bool ProfiledSegment::isErrorState() const
+{
+	return m_segment->isErrorState();
+}
+
+const bool ProfiledSegment::run()
+{
+	m_unit.start = m_profile->elapsed();
+	const bool ret = m_segment->run();
+	if(!ret) markEnd();
+	return ret;
+}
+
+void ProfiledSegment::join()
+{
+	m_segment->join();
+	markEnd();
+}
+
+const bool ProfiledSegment::running() const
+{
+	const bool ret = m_segment->running();
+	if(!ret) markEnd();
+	return ret;
+}
+
+const bool ProfiledSegment::parallel() const
+{
+	return m_segment->parallel();
+}
+
+void ProfiledSegment::finalize()
+{
+	m_segment->finalize();
+	markEnd();
+	m_unit.success = !m_segment->isErrorState();
+
+	m_session.out()->seek(0);
+	session()->out()->write(m_session.out()->readAll());
+	m_session.err()->seek(0);
+	session()->err()->write(BuildProfile::takeReport(m_session.err()->readAll(), &m_unit));
+
+	if(!m_timeTrace.isEmpty()) BuildProfile::readTimeTrace(m_timeTrace, &m_unit);
+	m_profile->addUnit(m_unit);
+}
+
+void ProfiledSegment::wait(int msecs)
+{
+	m_segment->wait(msecs);
+}
+
+void ProfiledSegment::cancel()
+{
+	m_segment->cancel();
+}
+
+void ProfiledSegment::markEnd() const
+{
+	if(m_unit.end < 0) m_unit.end = m_profile->elapsed();
+}
@@ -0,0 +1,38 @@
+#include "BuildProfileTab.h"
+
+#include "MainWindow.h"
+
+#include <QPlainTextEdit>
+#include <QVBoxLayout>
+#include <QLabel>
+#include <QFont>
+
+BuildProfileTab::BuildProfileTab(const QString& name, const QString& report, const QString& tracePath, MainWindow* parent)
+	: QWidget(parent), TabbedWidget(this, parent), m_name(name), m_tracePath(tracePath), m_report(new QPlainTextEdit(this))
+{
+	QVBoxLayout* layout = new QVBoxLayout(this);
+	if(!m_tracePath.isEmpty()) {
+		QLabel* trace = new QLabel(tr("Open %1 in chrome://tracing for a timeline of this build.").arg(m_tracePath), this);
+		trace->setTextInteractionFlags(Qt::TextSelectableByMouse);
+		layout->addWidget(trace);
+	}
+	layout->addWidget(m_report);
+	
+	QFont font("Courier");
+	font.setStyleHint(QFont::TypeWriter);
+	m_report->setFont(font);
+	m_report->setReadOnly(true);
+	m_report->setLineWrapMode(QPlainTextEdit::NoWrap);
+	m_report->setPlainText(report);
+}
+
+void BuildProfileTab::activate()
+{
+	mainWindow()->setTitle(tr("Build Profile - %1").arg(m_name));
+	mainWindow()->hideErrors();
+}
+
+bool BuildProfileTab::beginSetup() { return true; }
+void BuildProfileTab::completeSetup() { mainWindow()->setTabName(this, tr("Profile: %1").arg(m_name)); }
+bool BuildProfileTab::close() { return true; }
+void BuildProfileTab::refreshSettings() {}
@@ -2,6 +2,74 @@
 #include <QDebug>
 #include <QBuffer>
 
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+// How long a cancelled QThreadSegment gets to wind down before it is terminated
+#define THREAD_CANCEL_GRACE_MSECS 500
+// Chains sharing a JobPool sleep this long between polls instead of spinning
+#define JOB_POOL_POLL_MSECS 2
+// Longest a chain waits on its oldest segment before checking the others, and for cancellation
+#define CHAIN_POLL_MSECS 10
+
+static void sleepMsecs(unsigned long msecs)
+{
+	QMutex mutex;
+	QWaitCondition condition;
+	mutex.lock();
+	condition.wait(&mutex, msecs);
+	mutex.unlock();
+}
+
+#pragma mark -
+#pragma mark CancellationToken
+
+CancellationToken::CancellationToken()
+	: m_cancelled(0), m_deadline(0)
+{
+	
+}
+
+void CancellationToken::cancel()
+{
+	m_cancelled.fetchAndStoreOrdered(1);
+}
+
+const bool CancellationToken::isCancelled() const
+{
+	return m_cancelled != 0 || deadlineExpired();
+}
+
+void CancellationToken::setDeadline(qint64 msecs)
+{
+	QMutexLocker locker(&m_deadlineMutex);
+	m_deadline = msecs;
+	m_timer.start();
+}
+
+const bool CancellationToken::hasDeadline() const
+{
+	QMutexLocker locker(&m_deadlineMutex);
+	return m_deadline > 0;
+}
+
+const bool CancellationToken::deadlineExpired() const
+{
+	QMutexLocker locker(&m_deadlineMutex);
+	return m_deadline > 0 && m_timer.hasExpired(m_deadline);
+}
+
+void CancellationToken::reset()
+{
+	m_cancelled.fetchAndStoreOrdered(0);
+	QMutexLocker locker(&m_deadlineMutex);
+	m_deadline = 0;
+	m_timer.invalidate();
+}
+
 #pragma mark -
 #pragma mark ChainSession
 
@@ -41,6 +109,7 @@ QIODevice* ChainSession::err()
 }
 
 ChainSegment::ChainSegment()
+	: m_session(0), m_timeout(0)
 {
 	
 }
@@ -60,6 +129,31 @@ ChainSession* ChainSegment::session()
 	return m_session;
 }
 
+void ChainSegment::setTimeout(qint64 msecs)
+{
+	m_timeout = msecs;
+}
+
+qint64 ChainSegment::timeout() const
+{
+	return m_timeout;
+}
+
+void ChainSegment::startClock()
+{
+	m_clock.start();
+}
+
+const bool ChainSegment::timedOut() const
+{
+	return m_timeout > 0 && m_clock.isValid() && m_clock.hasExpired(m_timeout);
+}
+
+void ChainSegment::wait(int msecs)
+{
+	if(running()) sleepMsecs(msecs);
+}
+
 #pragma mark -
 #pragma mark QThreadSegment
 
@@ -93,6 +187,11 @@ void QThreadSegment::join()
 	m_thread->wait();
 }
 
+void QThreadSegment::wait(int msecs)
+{
+	m_thread->wait(msecs);
+}
+
 const bool QThreadSegment::parallel() const
 {
 	return m_parallel;
@@ -104,13 +203,68 @@ const bool QThreadSegment::isErrorState() const
 	return errState ? errState->isErrorState() : false;
 }
 
+void QThreadSegment::cancel()
+{
+	if(!running()) return;
+	Cancellable* cancellable = dynamic_cast<Cancellable*>(m_thread);
+	if(cancellable) {
+		cancellable->cancel();
+		if(m_thread->wait(THREAD_CANCEL_GRACE_MSECS)) return;
+		qWarning() << "Thread segment did not respond to cancellation. Terminating.";
+	} else qWarning() << "Thread segment can't be cancelled. Terminating.";
+	m_thread->terminate();
+	m_thread->wait();
+}
+
+
+#pragma mark -
+#pragma mark JobPool
+
+JobPool::JobPool(int jobs)
+	: m_jobs(jobs > 0 ? jobs : 1), m_available(m_jobs)
+{
+	
+}
+
+const bool JobPool::tryAcquire(int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	if(!m_available && msecs > 0) m_released.wait(&m_mutex, msecs);
+	if(!m_available) return false;
+	--m_available;
+	return true;
+}
+
+void JobPool::release()
+{
+	QMutexLocker locker(&m_mutex);
+	++m_available;
+	m_released.wakeAll();
+}
+
+void JobPool::wait(int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	m_released.wait(&m_mutex, msecs);
+}
+
+int JobPool::jobs() const
+{
+	return m_jobs;
+}
 
 #pragma mark -
 #pragma mark CommandChain
 
 CommandChain::CommandChain(quint16 maxConcurrentSegments)
 	: m_maxConcurrentSegments(maxConcurrentSegments),
-	m_chainSession(0)
+	m_chainSession(0),
+	m_token(0),
+	m_jobPool(0),
+	m_segmentTimeout(0),
+	m_timeout(0),
+	m_cancelled(false),
+	m_timedOut(false)
 {
 	
 }
@@ -118,11 +272,7 @@ CommandChain::CommandChain(quint16 maxConcurrentSegments)
 CommandChain::~CommandChain()
 {
 	drainExecuting();
-	while(m_chain.size()) {
-		ChainSegment* segment = m_chain.front();
-		m_chain.pop_front();
-		delete segment;
-	}
+	discardChain();
 	if(m_chainSession) delete m_chainSession;
 }
 
@@ -140,14 +290,22 @@ bool CommandChain::execute()
 {
 	if(m_chainSession) delete m_chainSession;
 	m_chainSession = new ChainSession();
-	while(m_chain.size()) {
+	m_cancelled = false;
+	m_timedOut = false;
+	m_clock.start();
+	while(m_chain.size() && !shouldStop()) {
 		if(!executeNextSegment()) {
 			drainExecuting();
 			return false;
 		}
 	}
-	if(drainExecuting()) return false;
-	return true;
+	const bool err = drainExecuting();
+	if(m_cancelled) {
+		qWarning() << "Chain execution was cancelled with" << m_chain.size() << "segments remaining";
+		discardChain();
+		return false;
+	}
+	return !err && !m_timedOut;
 }
 
 const Chain& CommandChain::chain() const
@@ -157,14 +315,21 @@ const Chain& CommandChain::chain() const
 
 const bool CommandChain::executeNextSegment()
 {
-	while(m_executing.size() >= m_maxConcurrentSegments) {
-		if(updateExecuting()) return false;
-		QThread::yieldCurrentThread();
+	while(!acquireJob()) {
+		if(m_executing.size() && updateExecuting()) return false;
+		if(shouldStop()) return true;
+		idle();
 	}
 	ChainSegment* segment = m_chain.front();
 	m_chain.pop_front();
-	if(!segment->parallel()) if(drainExecuting()) return false;
+	if(!segment->parallel() && drainExecuting()) {
+		releaseJob();
+		delete segment;
+		return false;
+	}
 	segment->setSession(m_chainSession);
+	if(segment->timeout() <= 0) segment->setTimeout(m_segmentTimeout);
+	segment->startClock();
 	m_executing.push_back(segment);
 	return segment->run();
 }
@@ -175,30 +340,113 @@ const bool CommandChain::updateExecuting()
 	
 	bool err = false;
 	Chain::iterator it = m_executing.begin();
-	for(; it != m_executing.end(); ++it) {
+	while(it != m_executing.end()) {
 		ChainSegment* segment = *it;
-		if(!segment->running()) {
+		if(segment->running() && segment->timedOut()) {
+			qWarning() << "Chain segment exceeded its timeout of" << segment->timeout() << "ms";
+			m_timedOut = true;
+			segment->cancel();
+		}
+		if(segment->running()) {
+			++it;
+			continue;
+		}
+		segment->finalize();
+		err |= segment->isErrorState();
+		it = m_executing.erase(it);
+		releaseJob();
+		delete segment;
+	}
+	return err;
+}
+
+const bool CommandChain::drainExecuting()
+{
+	bool watched = m_token || m_timeout > 0;
+	foreach(ChainSegment* segment, m_executing) watched |= segment->timeout() > 0;
+	
+	bool err = false;
+	// Without anything to watch for we can block on each segment in turn.
+	// Otherwise poll so cancellation and timeouts are noticed promptly.
+	if(!watched) {
+		while(m_executing.size()) {
+			ChainSegment* segment = m_executing.front();
+			segment->join();
 			segment->finalize();
 			err |= segment->isErrorState();
-			it = m_executing.erase(it); --it;
+			m_executing.pop_front();
+			releaseJob();
 			delete segment;
 		}
+		return err;
+	}
+	
+	while(m_executing.size()) {
+		if(shouldStop()) {
+			cancelExecuting();
+			return true;
+		}
+		err |= updateExecuting();
+		idle();
 	}
 	return err;
 }
 
-const bool CommandChain::drainExecuting()
+const bool CommandChain::shouldStop()
 {
-	bool err = false;
+	if(m_cancelled) return true;
+	if(m_token && m_token->isCancelled()) {
+		m_cancelled = true;
+		m_timedOut = m_token->deadlineExpired();
+	} else if(m_timeout > 0 && m_clock.hasExpired(m_timeout)) {
+		qWarning() << "Chain exceeded its timeout of" << m_timeout << "ms";
+		m_cancelled = true;
+		m_timedOut = true;
+	}
+	return m_cancelled;
+}
+
+void CommandChain::cancelExecuting()
+{
+	foreach(ChainSegment* segment, m_executing) segment->cancel();
 	while(m_executing.size()) {
 		ChainSegment* segment = m_executing.front();
 		segment->join();
 		segment->finalize();
-		err |= segment->isErrorState();
 		m_executing.pop_front();
+		releaseJob();
+		delete segment;
+	}
+}
+
+void CommandChain::discardChain()
+{
+	while(m_chain.size()) {
+		ChainSegment* segment = m_chain.front();
+		m_chain.pop_front();
 		delete segment;
 	}
-	return err;
+}
+
+const bool CommandChain::acquireJob()
+{
+	if(m_executing.size() >= m_maxConcurrentSegments) return false;
+	// Nothing of ours to poll, so block on the pool for a while
+	return !m_jobPool || m_jobPool->tryAcquire(m_executing.isEmpty() ? JOB_POOL_POLL_MSECS : 0);
+}
+
+void CommandChain::releaseJob()
+{
+	if(m_jobPool) m_jobPool->release();
+}
+
+void CommandChain::idle()
+{
+	// A pool wakes us when any chain frees a slot. Otherwise block on our oldest segment.
+	if(m_jobPool) m_jobPool->wait(JOB_POOL_POLL_MSECS);
+	else if(m_executing.size()) m_executing.front()->wait(CHAIN_POLL_MSECS);
+	else sleepMsecs(CHAIN_POLL_MSECS);
+	foreach(ChainSegment* segment, m_executing) segment->wait(0);
 }
 
 ChainSession* CommandChain::chainSession()
@@ -206,15 +454,77 @@ ChainSession* CommandChain::chainSession()
 	return m_chainSession;
 }
 
+void CommandChain::setCancellationToken(CancellationToken* token)
+{
+	m_token = token;
+}
+
+CancellationToken* CommandChain::cancellationToken() const
+{
+	return m_token;
+}
+
+void CommandChain::setJobPool(JobPool* pool)
+{
+	m_jobPool = pool;
+}
+
+JobPool* CommandChain::jobPool() const
+{
+	return m_jobPool;
+}
+
+void CommandChain::setSegmentTimeout(qint64 msecs)
+{
+	m_segmentTimeout = msecs;
+}
+
+qint64 CommandChain::segmentTimeout() const
+{
+	return m_segmentTimeout;
+}
+
+void CommandChain::setTimeout(qint64 msecs)
+{
+	m_timeout = msecs;
+}
+
+qint64 CommandChain::timeout() const
+{
+	return m_timeout;
+}
+
+const bool CommandChain::cancelled() const
+{
+	return m_cancelled;
+}
+
+const bool CommandChain::timedOut() const
+{
+	return m_timedOut;
+}
+
+#pragma mark -
+#pragma mark QProcessSegmentProcess
+
+void QProcessSegmentProcess::setupChildProcess()
+{
+#ifdef Q_OS_UNIX
+	// Give every segment its own process group so that cancellation can take
+	// down anything the program spawned as well (e.g. cc1 and as under gcc)
+	::setpgid(0, 0);
+#endif
+}
+
 #pragma mark -
 #pragma mark QProcessSegment
 
 QProcessSegment::QProcessSegment(const QString& program, const QStringList& args, bool parallel)
-	: m_program(program), m_args(args), m_parallel(parallel) {}
+	: m_program(program), m_args(args), m_parallel(parallel), m_cancelled(false) {}
 
 const bool QProcessSegment::isErrorState() const
 {
-	return m_process.exitStatus() != QProcess::NormalExit || m_process.exitCode() != 0;
+	return m_cancelled || m_process.exitStatus() != QProcess::NormalExit || m_process.exitCode() != 0;
 }
 	
 const bool QProcessSegment::run()
@@ -235,6 +545,11 @@ const bool QProcessSegment::running() const
 	return m_process.state() != QProcess::NotRunning;
 }
 
+void QProcessSegment::wait(int msecs)
+{
+	if(m_process.state() != QProcess::NotRunning) m_process.waitForFinished(msecs);
+}
+
 const bool QProcessSegment::parallel() const
 {
 	return m_parallel;
@@ -247,6 +562,17 @@ void QProcessSegment::finalize()
 	s->err()->write(m_process.readAllStandardError());
 }
 
+void QProcessSegment::cancel()
+{
+	m_cancelled = true;
+	if(m_process.state() == QProcess::NotRunning) return;
+	qDebug() << "Killing" << m_program;
+#ifdef Q_OS_UNIX
+	if(m_process.pid() > 0) ::kill(-m_process.pid(), SIGKILL);
+#endif
+	m_process.kill();
+}
+
 QProcess* QProcessSegment::process()
 {
 	return &m_process;
@@ -255,7 +581,7 @@ QProcess* QProcessSegment::process()
 #pragma mark -
 #pragma mark TimeSegment
 
-TimeSegment::TimeSegment(long time) : m_time(time) {}
+TimeSegment::TimeSegment(long time) : m_time(time), m_cancelled(false) {}
 
 const bool TimeSegment::isErrorState() const
 {
@@ -275,15 +601,26 @@ void TimeSegment::finalize()
 
 void TimeSegment::join()
 {
-	while(running()) QThread::yieldCurrentThread();
+	while(running()) wait(m_time);
 }
 
 const bool TimeSegment::running() const
 {
-	return !timer.hasExpired(m_time);
+	return !m_cancelled && !timer.hasExpired(m_time);
 }
 
 const bool TimeSegment::parallel() const
 {
 	return true;
+}
+
+void TimeSegment::wait(int msecs)
+{
+	if(!running()) return;
+	sleepMsecs(qMax(0LL, qMin((qint64)msecs, (qint64)m_time - timer.elapsed())));
+}
+
+void TimeSegment::cancel()
+{
+	m_cancelled = true;
 }
\ No newline at end of file
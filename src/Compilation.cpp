@@ -2,6 +2,7 @@
 
 #include "Compiler.h"
 #include "ProjectManager.h"
+#include "BuildProfile.h"
 
 #include <QDebug>
 #include <QFileInfo>
@@ -9,25 +10,31 @@
 #include <QFileInfo>
 
 Compilation::Compilation(const QList<Compiler*>& compilers, const QMap<QString, QString>& settings)
-	: m_compilers(compilers), m_settings(settings), m_name(""), m_results(true)
+	: m_compilers(compilers), m_settings(settings), m_name(""), m_project(0), m_results(true), m_jobPool(0), m_toolchainResolved(false), m_profile(0)
 {
-	
+	setProfiling(m_settings.value(PROFILE_BUILD_KEY) == "true");
 }
 
 Compilation::Compilation(const QList<Compiler*>& compilers, Project* project)
-	: m_compilers(compilers), m_settings(project->settings()), m_results(true)
+	: m_compilers(compilers), m_settings(project->settings()), m_project(project), m_results(true), m_jobPool(0), m_toolchainResolved(false), m_profile(0)
 {
+	setProfiling(m_settings.value(PROFILE_BUILD_KEY) == "true");
 	m_name = project->name();
 	addFiles(ProjectManager::ref().archiveWriter(project)->files());
 }
 
 Compilation::Compilation(const QList<Compiler*>& compilers, const QString& file)
-	: m_compilers(compilers), m_results(true)
+	: m_compilers(compilers), m_project(0), m_results(true), m_jobPool(0), m_toolchainResolved(false), m_profile(0)
 {
 	m_name = QFileInfo(file).baseName();
 	addFile(file);
 }
 
+Compilation::~Compilation()
+{
+	delete m_profile;
+}
+
 void Compilation::addFile(const QString& file, bool remove)
 {
 	if(QFileInfo(file).completeSuffix().isEmpty()) {
@@ -74,9 +81,27 @@ const QMap<QString, QString>& Compilation::settings() const
 }
 
 const bool Compilation::start()
+{
+	const bool ret = compileFiles();
+	if(m_profile) {
+		const QString name = m_name.isEmpty() ? QString("compilation") : m_name;
+		m_profile->save(Compiler::rootOutputDirectory().absoluteFilePath(name + "-trace.json"));
+		qDebug() << "Build profile:" << endl << qPrintable(m_profile->report());
+	}
+	return ret;
+}
+
+const bool Compilation::compileFiles()
 {
 	qDebug() << "Compilation starting with" << m_files;
+	const qint64 timeout = m_settings.value(COMPILE_TIMEOUT_KEY).toLongLong();
+	if(timeout > 0) m_token.setDeadline(timeout);
 	while(!m_files.isEmpty()) {
+		if(m_token.isCancelled()) {
+			qWarning() << "Compilation cancelled";
+			m_results.setCancelled(true);
+			return false;
+		}
 		const QStringList files = m_files.values();
 		const QString ext = QFileInfo(files[0]).completeSuffix();
 		const QStringList filtered = files.filter(QRegExp(QString(".+\\.") + ext));
@@ -87,6 +112,64 @@ const bool Compilation::start()
 	return true;
 }
 
+void Compilation::cancel()
+{
+	m_token.cancel();
+}
+
+const bool Compilation::isCancelled() const
+{
+	return m_token.isCancelled();
+}
+
+CancellationToken* Compilation::cancellationToken()
+{
+	return &m_token;
+}
+
+qint64 Compilation::segmentTimeout() const
+{
+	return m_settings.value(SEGMENT_TIMEOUT_KEY).toLongLong();
+}
+
+void Compilation::setJobPool(JobPool* pool)
+{
+	m_jobPool = pool;
+}
+
+JobPool* Compilation::jobPool() const
+{
+	return m_jobPool;
+}
+
+void Compilation::setupChain(CommandChain* chain)
+{
+	chain->setCancellationToken(&m_token);
+	chain->setJobPool(m_jobPool);
+	chain->setSegmentTimeout(segmentTimeout());
+}
+
+const Toolchain& Compilation::toolchain()
+{
+	if(m_toolchainResolved) return m_toolchain;
+	m_toolchain = CompilerManager::ref().toolchain(m_settings.value(TARGET_KEY), m_settings.value(TOOLCHAIN_KEY));
+	m_toolchainResolved = true;
+	qDebug() << "Compilation" << m_name << "uses toolchain" << m_toolchain.path << m_toolchain.version;
+	return m_toolchain;
+}
+
+void Compilation::setProfiling(bool profiling)
+{
+	if(profiling == (m_profile != 0)) return;
+	delete m_profile;
+	m_profile = profiling ? new BuildProfile() : 0;
+}
+
+BuildProfile* Compilation::profile() const
+{
+	return m_profile;
+}
+
 const bool Compilation::compile(const QStringList& files, Compiler* compiler)
 {
 	m_files -= QSet<QString>::fromList(files);
@@ -95,9 +178,10 @@ const bool Compilation::compile(const QStringList& files, Compiler* compiler)
 		return true;
 	}
 	qDebug() << "Compiling" << files << "with" << compiler->name();
-	CompileResult result = compiler->compile(this, files);
-	qDebug() << result.categorizedOutput();
+	foreach(CompilationListener* listener, listeners()) listener->compilationUnitStarted(this, compiler->name(), files);
+	const CompileResult result = compiler->compile(this, files);
 	m_results += result;
+	foreach(CompilationListener* listener, listeners()) listener->compilationUnitFinished(this, result);
 	return result.success();
 }
 
@@ -0,0 +1,152 @@
+#include "CompilationService.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#pragma mark -
+#pragma mark CompilationThread
+
+CompilationThread::CompilationThread(Compilation* compilation, QObject* parent)
+	: QThread(parent), m_compilation(compilation), m_success(false)
+{
+	m_compilation->addListener(this);
+}
+
+Compilation* CompilationThread::compilation() const
+{
+	return m_compilation;
+}
+
+const bool CompilationThread::success() const
+{
+	return m_success;
+}
+
+void CompilationThread::cancel()
+{
+	m_compilation->cancel();
+}
+
+void CompilationThread::compilationUnitStarted(Compilation*, const QString& compiler, const QStringList& files)
+{
+	emit unitStarted(compiler, files);
+}
+
+void CompilationThread::compilationUnitFinished(Compilation*, const CompileResult& result)
+{
+	emit unitFinished(result);
+}
+
+void CompilationThread::run()
+{
+	m_success = m_compilation->start();
+}
+
+#pragma mark -
+#pragma mark CompilationService
+
+CompilationService::CompilationService()
+	: m_running(0)
+{
+	qRegisterMetaType<CompileResult>("CompileResult");
+}
+
+CompilationService::~CompilationService()
+{
+	cancelAll();
+	if(!m_running) return;
+	m_running->wait();
+	delete m_running->compilation();
+	delete m_running;
+}
+
+void CompilationService::submit(Compilation* compilation, const QString& key, Policy policy)
+{
+	if(policy == Supersede) cancel(key);
+	
+	Pending pending;
+	pending.compilation = compilation;
+	pending.key = key;
+	m_pending.append(pending);
+	
+	if(!m_running) startNext();
+}
+
+void CompilationService::cancel(const QString& key)
+{
+	QList<Pending>::iterator it = m_pending.begin();
+	while(it != m_pending.end()) {
+		if(it->key != key) {
+			++it;
+			continue;
+		}
+		Compilation* compilation = it->compilation;
+		it = m_pending.erase(it);
+		discard(compilation);
+	}
+	if(m_running && m_runningKey == key) m_running->cancel();
+}
+
+void CompilationService::cancelAll()
+{
+	while(!m_pending.isEmpty()) discard(m_pending.takeFirst().compilation);
+	if(m_running) m_running->cancel();
+}
+
+const bool CompilationService::isBusy() const
+{
+	return m_running || !m_pending.isEmpty();
+}
+
+void CompilationService::threadUnitStarted(const QString& compiler, const QStringList& files)
+{
+	if(!m_running) return;
+	emit unitStarted(m_running->compilation(), compiler, files);
+}
+
+void CompilationService::threadUnitFinished(const CompileResult& result)
+{
+	if(!m_running) return;
+	emit unitFinished(m_running->compilation(), result);
+}
+
+void CompilationService::threadFinished()
+{
+	if(!m_running) return;
+	
+	// Deliver any progress signals still queued behind finished() first
+	QCoreApplication::sendPostedEvents(this, 0);
+	
+	CompilationThread* thread = m_running;
+	m_running = 0;
+	
+	Compilation* compilation = thread->compilation();
+	emit compilationFinished(compilation, thread->success());
+	delete compilation;
+	thread->deleteLater();
+	
+	startNext();
+}
+
+void CompilationService::discard(Compilation* compilation)
+{
+	// Whoever submitted it may still be waiting to hear about it
+	compilation->cancel();
+	emit compilationFinished(compilation, false);
+	delete compilation;
+}
+
+void CompilationService::startNext()
+{
+	if(m_running || m_pending.isEmpty()) return;
+	
+	const Pending next = m_pending.takeFirst();
+	m_running = new CompilationThread(next.compilation, this);
+	m_runningKey = next.key;
+	connect(m_running, SIGNAL(unitStarted(QString, QStringList)), SLOT(threadUnitStarted(QString, QStringList)));
+	connect(m_running, SIGNAL(unitFinished(CompileResult)), SLOT(threadUnitFinished(CompileResult)));
+	connect(m_running, SIGNAL(finished()), SLOT(threadFinished()));
+	
+	emit compilationStarted(next.compilation);
+	m_running->start();
+}
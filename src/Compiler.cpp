@@ -21,18 +21,28 @@
 #include "Compiler.h"
 
 #include "Temporary.h"
+#include "Compilation.h"
+#include "CommandChain.h"
+#include "GccOutput.h"
+#include "ErrorWidget.h"
 
 #include <QVariant>
 #include <QScriptEngine>
+#include <QThread>
+#include <QSet>
+#include <QFileInfo>
 #include <QDebug>
 
 CompileResult::CompileResult(bool success, const QMap<QString, QStringList>& categorizedOutput, const QString& raw)
-	: m_success(success), m_categorizedOutput(categorizedOutput), m_raw(raw)
+	: m_success(success), m_cancelled(false), m_raw(raw), m_categorizedDirty(true),
+	m_diagnosticsDirty(false)
 {
-	
+	QMap<QString, QStringList>::const_iterator it = categorizedOutput.constBegin();
+	for(; it != categorizedOutput.constEnd(); ++it) addOutput(it.key(), it.value());
 }
 
-CompileResult::CompileResult(bool success) : m_success(success)
+CompileResult::CompileResult(bool success) : m_success(success), m_cancelled(false), m_categorizedDirty(false),
+	m_diagnosticsDirty(false)
 {
 	
 }
@@ -42,6 +52,17 @@ const bool CompileResult::success() const
 	return m_success;
 }
 
+const bool CompileResult::cancelled() const
+{
+	return m_cancelled;
+}
+
+void CompileResult::setCancelled(bool cancelled)
+{
+	m_cancelled = cancelled;
+	if(m_cancelled) m_success = false;
+}
+
 const QString& CompileResult::raw() const
 {
 	return m_raw;
@@ -49,33 +70,89 @@ const QString& CompileResult::raw() const
 
 const QStringList CompileResult::output(const QString& category) const
 {
-	return m_categorizedOutput.value(category);
+	return categorizedOutput().value(category);
 }
 
 const QMap<QString, QStringList>& CompileResult::categorizedOutput() const
 {
+	if(!m_categorizedDirty) return m_categorizedOutput;
+	
+	m_categorizedOutput.clear();
+	foreach(const CompileOutputLine& line, m_output) m_categorizedOutput[line.category].append(line.message);
+	m_categorizedDirty = false;
 	return m_categorizedOutput;
 }
 
+void CompileResult::addOutput(const QString& category, const QString& message)
+{
+	CompileOutputLine line;
+	line.category = category;
+	line.message = message;
+	m_output.append(line);
+	m_categorizedDirty = true;
+}
+
+void CompileResult::addOutput(const QString& category, const QStringList& messages)
+{
+	m_output.reserve(m_output.size() + messages.size());
+	foreach(const QString& message, messages) addOutput(category, message);
+}
+
+const DiagnosticList& CompileResult::diagnostics() const
+{
+	return m_diagnostics;
+}
+
+void CompileResult::setDiagnostics(const DiagnosticList& diagnostics)
+{
+	m_diagnostics = diagnostics;
+	m_diagnosticsDirty = true;
+}
+
+const DiagnosticList CompileResult::diagnosticsForFile(const QString& path) const
+{
+	if(m_diagnosticsDirty) {
+		m_diagnosticsByFile.clear();
+		foreach(const Diagnostic& diag, m_diagnostics) {
+			m_diagnosticsByFile[QDir::cleanPath(QFileInfo(diag.file).absoluteFilePath())].append(diag);
+		}
+		m_diagnosticsDirty = false;
+	}
+	return m_diagnosticsByFile.value(QDir::cleanPath(QFileInfo(path).absoluteFilePath()));
+}
+
+const QMap<QString, qint64>& CompileResult::timings() const
+{
+	return m_timings;
+}
+
+void CompileResult::addTiming(const QString& stage, qint64 msecs)
+{
+	m_timings[stage] += msecs;
+}
+
 void CompileResult::clear()
 {
+	m_output.clear();
 	m_categorizedOutput.clear();
+	m_categorizedDirty = false;
+	m_diagnostics.clear();
+	m_diagnosticsByFile.clear();
+	m_diagnosticsDirty = false;
+	m_timings.clear();
 }
 
 void CompileResult::addCompileResult(const CompileResult& rhs)
 {
-	const QMap<QString, QStringList>& other = rhs.categorizedOutput();
-	m_categorizedOutput.unite(other);
-	foreach(const QString& category, m_categorizedOutput.uniqueKeys()) {
-		const QList<QStringList>& values = m_categorizedOutput.values(category);
-		qDebug() << "Uniting" << values;
-		QStringList res;
-		foreach(const QStringList& list, values) res << list;
-		m_categorizedOutput.remove(category);
-		qDebug() << "Done" << res;
-		m_categorizedOutput[category] = res;
-	}
+	if(m_output.isEmpty()) m_output = rhs.m_output;
+	else m_output += rhs.m_output;
+	m_categorizedDirty |= !rhs.m_output.isEmpty();
 	m_success &= rhs.success();
+	m_cancelled |= rhs.cancelled();
+	m_diagnostics += rhs.diagnostics();
+	m_diagnosticsDirty |= !rhs.diagnostics().isEmpty();
+	QMap<QString, qint64>::const_iterator it = rhs.m_timings.constBegin();
+	for(; it != rhs.m_timings.constEnd(); ++it) m_timings[it.key()] += it.value();
 	m_raw += rhs.raw();
 }
 
@@ -87,8 +164,7 @@ CompileResult& CompileResult::operator+=(const CompileResult& rhs)
 
 CompileResult CompileResult::operator+(const CompileResult& rhs) const
 {
-	CompileResult ret(m_success);
-	ret += *this;
+	CompileResult ret(*this);
 	ret += rhs;
 	return ret;
 }
@@ -108,6 +184,11 @@ const QList<Compiler*>& CompilerManager::compilers() const
 	return m_compilers;
 }
 
+Toolchain CompilerManager::toolchain(const QString& target, const QString& preferred) const
+{
+	return ToolchainRegistry::ref().toolchain(target, preferred);
+}
+
 
 Compiler::Compiler(const QString& name, const QStringList& types) : m_name(name), m_types(types)
 {
@@ -139,18 +220,214 @@ QDir Compiler::outputDirectory()
 	return d;
 }
 
+#pragma mark -
+#pragma mark CompilerPluginInvoker
+
+CompilerPluginInvoker::CompilerPluginInvoker(const QScriptValue& plugin)
+	: m_plugin(plugin), m_pending(false), m_finished(false)
+{
+}
+
+ScriptCompilePlan CompilerPluginInvoker::plan(Compilation* compilation, const QStringList& files, const QString& outputDirectory)
+{
+	// One request in flight at a time
+	QMutexLocker call(&m_callMutex);
+	
+	m_mutex.lock();
+	m_files = files;
+	m_settings = compilation->settings();
+	m_outputDirectory = outputDirectory;
+	m_pending = true;
+	m_finished = false;
+	
+	if(QThread::currentThread() == thread()) {
+		m_mutex.unlock();
+		invoke();
+		return m_plan;
+	}
+	
+	QMetaObject::invokeMethod(this, "invoke", Qt::QueuedConnection);
+	// Waits in slices so that cancelling the compilation (which happens before
+	// anyone waits on the compilation thread) can't leave us blocked forever
+	while(!m_finished) {
+		m_finishedCondition.wait(&m_mutex, 100);
+		if(m_finished || !compilation->isCancelled()) continue;
+		m_pending = false;
+		m_mutex.unlock();
+		ScriptCompilePlan ret;
+		ret.error = "Cancelled";
+		return ret;
+	}
+	const ScriptCompilePlan ret = m_plan;
+	m_mutex.unlock();
+	return ret;
+}
+
+void CompilerPluginInvoker::invoke()
+{
+	QMutexLocker lock(&m_mutex);
+	if(!m_pending) return;
+	m_pending = false;
+	
+	QScriptEngine* engine = m_plugin.engine();
+	QScriptValue settings = engine->newObject();
+	QMap<QString, QString>::const_iterator it = m_settings.constBegin();
+	for(; it != m_settings.constEnd(); ++it) settings.setProperty(it.key(), it.value());
+	
+	const QScriptValue ret = m_plugin.property("compile").call(m_plugin, QScriptValueList()
+		<< engine->toScriptValue(m_files) << settings << m_outputDirectory);
+	if(engine->hasUncaughtException()) {
+		m_plan = ScriptCompilePlan();
+		m_plan.error = "compile() threw " + engine->uncaughtException().toString();
+		engine->clearExceptions();
+	} else m_plan = planFromScript(ret, m_outputDirectory);
+	
+	m_finished = true;
+	m_finishedCondition.wakeAll();
+}
+
+ScriptCompilePlan CompilerPluginInvoker::planFromScript(const QScriptValue& value, const QString& outputDirectory)
+{
+	ScriptCompilePlan ret;
+	QScriptValue jobs = value;
+	if(!value.isArray() && value.isObject()) {
+		jobs = value.property("jobs");
+		ret.outputs = value.property("outputs").toVariant().toStringList();
+		if(value.property("parser").isString()) ret.parser = value.property("parser").toString();
+	}
+	if(!jobs.isArray()) {
+		ret.error = "compile() must return an array of jobs or an object with a \"jobs\" array";
+		return ret;
+	}
+	
+	const quint32 length = jobs.property("length").toUInt32();
+	for(quint32 i = 0; i < length; ++i) {
+		const QScriptValue job = jobs.property(i);
+		ScriptCompileJob parsed;
+		parsed.id = job.property("id").isUndefined() ? QString("job%1").arg(i) : job.property("id").toString();
+		parsed.program = job.property("program").toString();
+		parsed.args = job.property("args").toVariant().toStringList();
+		parsed.workingDirectory = job.property("workingDirectory").isString()
+			? job.property("workingDirectory").toString() : outputDirectory;
+		const QScriptValue deps = job.property("dependsOn");
+		if(deps.isString()) parsed.dependsOn << deps.toString();
+		else if(deps.isArray()) parsed.dependsOn = deps.toVariant().toStringList();
+		
+		if(job.property("program").isUndefined() || parsed.program.isEmpty()) {
+			ret.error = QString("Job \"%1\" has no program").arg(parsed.id);
+			return ret;
+		}
+		ret.jobs << parsed;
+	}
+	return ret;
+}
+
+#pragma mark -
+#pragma mark CompilerPlugin
+
 CompilerPlugin::CompilerPlugin(const QScriptValue& plugin)
-	: Compiler(plugin.property("name").toString(), plugin.property("types").toVariant().toStringList()), m_plugin(plugin)
+	: Compiler(plugin.property("name").toString(), plugin.property("types").toVariant().toStringList()), m_plugin(plugin),
+	m_invoker(new CompilerPluginInvoker(plugin))
 {
 	if(m_plugin.property("compile").isUndefined()) {
 		qCritical() << "Compiler plugin" << name() << "does not have \"compile\" property.";
 	}
 }
 
+CompilerPlugin::~CompilerPlugin()
+{
+	delete m_invoker;
+}
+
 CompileResult CompilerPlugin::compile(Compilation* compilation, const QStringList& files)
 {
-	QScriptValue ret = m_plugin.property("compile").call(QScriptValue(), QScriptValueList() << m_plugin.engine()->toScriptValue(files));
+	const ScriptCompilePlan plan = m_invoker->plan(compilation, files, outputDirectory().path());
+	QString error = plan.error;
+	QList<QList<ScriptCompileJob> > levels;
+	if(error.isEmpty()) levels = schedule(plan.jobs, &error);
+	if(!error.isEmpty()) {
+		CompileResult ret(false);
+		ret.setCancelled(compilation->isCancelled());
+		ret.addOutput(DEFAULT_ERROR_KEY, name() + ": " + error);
+		return ret;
+	}
+	
+	const int idealProcesses = QThread::idealThreadCount();
+	CommandChain chain(idealProcesses > 0 ? idealProcesses : 1);
+	compilation->setupChain(&chain);
+	for(int level = 0; level < levels.size(); ++level) {
+		for(int i = 0; i < levels[level].size(); ++i) {
+			const ScriptCompileJob& job = levels[level][i];
+			// A non-parallel segment waits for everything before it, which
+			// makes the first job of each level a barrier for the previous one
+			QProcessSegment* segment = new QProcessSegment(job.program, job.args, level == 0 || i > 0);
+			segment->process()->setWorkingDirectory(job.workingDirectory);
+			chain.add(segment);
+		}
+	}
+	
+	const bool success = chain.execute();
+	QIODevice* err = chain.chainSession()->err();
+	err->seek(0);
 	
-	QMap<QString, QStringList> a;
-	return CompileResult(false, a);
-}
\ No newline at end of file
+	CompileResult result(success);
+	result.setCancelled(chain.cancelled() || chain.timedOut());
+	if(success) {
+		const QDir dir = outputDirectory();
+		foreach(const QString& output, plan.outputs) compilation->addFile(dir.absoluteFilePath(output));
+	}
+	return result + parseOutput(plan.parser, err, success);
+}
+
+QList<QList<ScriptCompileJob> > CompilerPlugin::schedule(const QList<ScriptCompileJob>& jobs, QString* error)
+{
+	QList<QList<ScriptCompileJob> > ret;
+	QSet<QString> ids;
+	foreach(const ScriptCompileJob& job, jobs) {
+		if(ids.contains(job.id)) {
+			*error = QString("More than one job is named \"%1\"").arg(job.id);
+			return QList<QList<ScriptCompileJob> >();
+		}
+		ids.insert(job.id);
+	}
+	foreach(const ScriptCompileJob& job, jobs) {
+		foreach(const QString& dep, job.dependsOn) {
+			if(ids.contains(dep)) continue;
+			*error = QString("Job \"%1\" depends on unknown job \"%2\"").arg(job.id).arg(dep);
+			return QList<QList<ScriptCompileJob> >();
+		}
+	}
+	
+	QSet<QString> done;
+	int scheduled = 0;
+	while(scheduled < jobs.size()) {
+		QList<ScriptCompileJob> level;
+		foreach(const ScriptCompileJob& job, jobs) {
+			if(done.contains(job.id)) continue;
+			bool ready = true;
+			foreach(const QString& dep, job.dependsOn) ready &= done.contains(dep);
+			if(ready) level << job;
+		}
+		if(level.isEmpty()) {
+			*error = "Jobs have circular dependencies";
+			return QList<QList<ScriptCompileJob> >();
+		}
+		foreach(const ScriptCompileJob& job, level) done.insert(job.id);
+		scheduled += level.size();
+		ret << level;
+	}
+	return ret;
+}
+
+CompileResult CompilerPlugin::parseOutput(const QString& parser, QIODevice* err, bool success) const
+{
+	if(parser == "gcc") return GccOutput::processCompilerOutput(err);
+	if(parser == "gcc-json") return GccOutput::processJsonCompilerOutput(err);
+	if(parser == "linker") return GccOutput::processLinkerOutput(err);
+	if(!parser.isEmpty()) qWarning() << "Compiler plugin" << name() << "asked for unknown parser" << parser;
+	
+	const QString raw = QString::fromLocal8Bit(err->readAll());
+	CompileResult ret(success);
+	ret.addOutput(success ? DEFAULT_WARNING_KEY : DEFAULT_ERROR_KEY, raw.split("\n", QString::SkipEmptyParts));
+	return ret;
+}
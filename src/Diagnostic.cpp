@@ -0,0 +1,50 @@
+#include "Diagnostic.h"
+
+#include <QFileInfo>
+
+DiagnosticNote::DiagnosticNote()
+	: line(0), column(0)
+{
+	
+}
+
+QString DiagnosticNote::toString() const
+{
+	Diagnostic diag;
+	diag.file = file;
+	diag.line = line;
+	diag.column = column;
+	diag.severity = Diagnostic::Note;
+	diag.message = message;
+	return diag.toString();
+}
+
+DiagnosticFixit::DiagnosticFixit()
+	: line(0), column(0), endLine(0), endColumn(0)
+{
+	
+}
+
+Diagnostic::Diagnostic()
+	: line(0), column(0), endLine(0), endColumn(0), severity(Error)
+{
+	
+}
+
+QString Diagnostic::toString() const
+{
+	QString ret = QFileInfo(file).fileName() + ":";
+	if(line > 0) ret += QString::number(line) + ":";
+	if(column > 0) ret += QString::number(column) + ":";
+	return ret + " " + severityName(severity) + ": " + message;
+}
+
+QString Diagnostic::severityName(Severity severity)
+{
+	switch(severity) {
+		case Error: return "error";
+		case Warning: return "warning";
+		case Note: return "note";
+	}
+	return QString();
+}
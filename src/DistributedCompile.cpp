@@ -0,0 +1,772 @@
+#include "DistributedCompile.h"
+
+#include <QTcpSocket>
+#include <QTcpServer>
+#include <QDataStream>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QFile>
+#include <QDir>
+#include <QRegExp>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <signal.h>
+#include <stdlib.h>
+#endif
+
+#include <zlib.h>
+
+#define CONNECT_MSECS 1000
+#define SOURCE_NAME "in.i"
+#define OBJECT_NAME "out.o"
+
+static void killProcess(QProcess* process)
+{
+#ifdef Q_OS_UNIX
+	if(process->pid() > 0) ::kill(-process->pid(), SIGKILL);
+#endif
+	process->kill();
+}
+
+#pragma mark -
+#pragma mark DistributedProtocol
+
+QByteArray DistributedProtocol::frame(const QByteArray& payload)
+{
+	QByteArray ret;
+	QDataStream stream(&ret, QIODevice::WriteOnly);
+	stream << (quint32)payload.size();
+	ret.append(payload);
+	return ret;
+}
+
+bool DistributedProtocol::takeFrame(QByteArray& buffer, QByteArray& payload)
+{
+	if(buffer.size() < (int)sizeof(quint32)) return false;
+	quint32 size = 0;
+	QDataStream stream(buffer);
+	stream >> size;
+	if(size > COMPILE_DAEMON_MAX_FRAME_BYTES) return false;
+	if((quint32)buffer.size() - sizeof(quint32) < size) return false;
+	payload = buffer.mid(sizeof(quint32), size);
+	buffer.remove(0, sizeof(quint32) + size);
+	return true;
+}
+
+bool DistributedProtocol::oversized(const QByteArray& buffer)
+{
+	if(buffer.size() < (int)sizeof(quint32)) return false;
+	quint32 size = 0;
+	QDataStream stream(buffer);
+	stream >> size;
+	return size > COMPILE_DAEMON_MAX_FRAME_BYTES;
+}
+
+bool DistributedProtocol::isRemoteArgument(const QString& arg)
+{
+	if(arg.contains('/') || arg.contains('\\')) return false;
+	// Options handed through to the assembler, linker or preprocessor
+	if(arg.startsWith("-Wa,") || arg.startsWith("-Wl,") || arg.startsWith("-Wp,")) return false;
+	if(arg.startsWith("-fplugin") || arg.startsWith("-fdump") || arg.startsWith("-fprofile")
+		|| arg.startsWith("-fauto-profile") || arg.startsWith("-fstack-usage")) return false;
+
+	if(arg == "-w") return true;
+	static const char* allowed[] = { "-W", "-f", "-O", "-g", "-m", "-std=", "-ansi", "-pedantic", 0 };
+	for(int i = 0; allowed[i]; ++i) {
+		if(arg.startsWith(allowed[i])) return true;
+	}
+	return false;
+}
+
+bool DistributedProtocol::uncompress(const QByteArray& data, QByteArray& out)
+{
+	out.clear();
+	if(data.size() < 4) return false;
+	// qCompress() puts the uncompressed size in front, big endian
+	const quint32 size = ((quint32)(uchar)data[0] << 24) | ((quint32)(uchar)data[1] << 16)
+		| ((quint32)(uchar)data[2] << 8) | (quint32)(uchar)data[3];
+	if(size > COMPILE_DAEMON_MAX_FILE_BYTES) return false;
+	if(!size) return true;
+
+	out.resize(size);
+	uLongf length = size;
+	if(::uncompress((Bytef*)out.data(), &length, (const Bytef*)data.constData() + 4, data.size() - 4) != Z_OK
+		|| length != size) {
+		out.clear();
+		return false;
+	}
+	return true;
+}
+
+CompileHost::CompileHost()
+	: port(COMPILE_DAEMON_DEFAULT_PORT), jobSlots(0), load(0), assigned(0), up(false) {}
+
+#pragma mark -
+#pragma mark CompileHostPool
+
+CompileHostPool::CompileHostPool(const QStringList& hosts, quint16 localSlots)
+	: m_localSlots(localSlots), m_localAssigned(0)
+{
+	foreach(const QString& entry, hosts) {
+		CompileHost host;
+		const int colon = entry.lastIndexOf(':');
+		host.address = colon < 0 ? entry : entry.left(colon);
+		if(colon >= 0) host.port = entry.mid(colon + 1).toUShort();
+		if(host.address.isEmpty() || !host.port) {
+			qWarning() << "Ignoring malformed compile host" << entry;
+			continue;
+		}
+		m_hosts << host;
+	}
+}
+
+void CompileHostPool::refresh(int msecs)
+{
+	const int count = m_hosts.size();
+	QList<QTcpSocket*> sockets;
+	QVector<QByteArray> buffers(count);
+	QVector<bool> sent(count, false);
+	QVector<bool> done(count, false);
+	for(int i = 0; i < count; ++i) {
+		m_hosts[i].up = false;
+		sockets << new QTcpSocket();
+		sockets[i]->connectToHost(m_hosts[i].address, m_hosts[i].port);
+	}
+
+	// Hosts are asked in parallel so that a room full of switched off
+	// machines costs msecs in total, not msecs each
+	QElapsedTimer timer;
+	timer.start();
+	int remaining = count;
+	while(remaining > 0 && timer.elapsed() < msecs) {
+		for(int i = 0; i < count; ++i) {
+			if(done[i]) continue;
+			QTcpSocket* socket = sockets[i];
+			if(socket->state() == QAbstractSocket::UnconnectedState) {
+				done[i] = true;
+				--remaining;
+				continue;
+			}
+			if(!sent[i]) {
+				if(!socket->waitForConnected(5)) continue;
+				m_hosts[i].resolved = socket->peerAddress();
+				QByteArray payload;
+				QDataStream stream(&payload, QIODevice::WriteOnly);
+				stream << (quint8)DistributedProtocol::Status;
+				socket->write(DistributedProtocol::frame(payload));
+				socket->flush();
+				sent[i] = true;
+			}
+			socket->waitForReadyRead(5);
+			buffers[i].append(socket->readAll());
+
+			QByteArray payload;
+			if(DistributedProtocol::oversized(buffers[i])) {
+				done[i] = true;
+				--remaining;
+				continue;
+			}
+			if(!DistributedProtocol::takeFrame(buffers[i], payload)) continue;
+			QDataStream stream(payload);
+			quint8 type = 0;
+			stream >> type >> m_hosts[i].jobSlots >> m_hosts[i].load;
+			m_hosts[i].up = type == DistributedProtocol::StatusReply && m_hosts[i].jobSlots > 0;
+			done[i] = true;
+			--remaining;
+		}
+	}
+	qDeleteAll(sockets);
+
+	foreach(const CompileHost& host, m_hosts) {
+		qDebug() << "Compile host" << host.address << host.port << (host.up ? "up" : "down")
+			<< "slots" << host.jobSlots << "load" << host.load;
+	}
+}
+
+int CompileHostPool::acquire()
+{
+	// Ties go to the local machine since it doesn't pay for the transfer
+	int best = -1;
+	double bestLoad = m_localSlots ? (double)m_localAssigned / m_localSlots : 1e9;
+	for(int i = 0; i < m_hosts.size(); ++i) {
+		const CompileHost& host = m_hosts[i];
+		if(!host.up) continue;
+		const double load = (double)(host.load + host.assigned) / host.jobSlots;
+		if(load < bestLoad) {
+			best = i;
+			bestLoad = load;
+		}
+	}
+	if(best < 0) ++m_localAssigned;
+	else ++m_hosts[best].assigned;
+	return best;
+}
+
+void CompileHostPool::release(int host)
+{
+	if(host < 0) {
+		if(m_localAssigned) --m_localAssigned;
+	} else if(m_hosts[host].assigned) --m_hosts[host].assigned;
+}
+
+void CompileHostPool::markDown(int host)
+{
+	if(host < 0) return;
+	qWarning() << "Compile host" << m_hosts[host].address << m_hosts[host].port << "stopped responding";
+	m_hosts[host].up = false;
+}
+
+const CompileHost& CompileHostPool::host(int host) const
+{
+	return m_hosts[host];
+}
+
+const QList<CompileHost>& CompileHostPool::hosts() const
+{
+	return m_hosts;
+}
+
+quint16 CompileHostPool::localSlots() const
+{
+	return m_localSlots;
+}
+
+quint32 CompileHostPool::totalSlots() const
+{
+	quint32 ret = m_localSlots;
+	foreach(const CompileHost& host, m_hosts) {
+		if(host.up) ret += host.jobSlots;
+	}
+	return ret;
+}
+
+QStringList CompileHostPool::parseHosts(const QString& spec)
+{
+	return spec.split(QRegExp("[,\\s]+"), QString::SkipEmptyParts);
+}
+
+#pragma mark -
+#pragma mark DistributedSegment
+
+DistributedSegment::DistributedSegment(CompileHostPool* pool, ChainSegment* local, const Toolchain& toolchain,
+		const QString& workingDirectory, const QStringList& args)
+	: m_pool(pool), m_local(local), m_toolchain(toolchain), m_workingDirectory(workingDirectory), m_args(args),
+	m_state(Idle), m_host(-1), m_acquired(false), m_cancelled(false), m_remote(false), m_preprocess(0), m_socket(0), m_exitCode(-1)
+{
+	for(int i = 0; i < args.size(); ++i) {
+		if(args[i] == "-c" && i + 1 < args.size()) m_source = args[++i];
+		else if(args[i] == "-o" && i + 1 < args.size()) m_object = args[++i];
+		else m_flags << args[i];
+	}
+}
+
+DistributedSegment::~DistributedSegment()
+{
+	delete m_preprocess;
+	delete m_socket;
+	delete m_local;
+}
+
+const bool DistributedSegment::isErrorState() const
+{
+	if(m_cancelled) return true;
+	if(m_state == Local) return m_local->isErrorState();
+	return m_exitCode != 0;
+}
+
+const bool DistributedSegment::run()
+{
+	if(m_source.isEmpty() || m_object.isEmpty()) return runLocally();
+	m_host = m_pool->acquire();
+	m_acquired = true;
+	if(m_host < 0) return runLocally();
+
+	m_preprocess = new QProcessSegmentProcess();
+	m_preprocess->setWorkingDirectory(m_workingDirectory);
+	m_preprocess->start(m_toolchain.path, QStringList(m_flags) << "-E" << m_source);
+	m_state = Preprocessing;
+	return true;
+}
+
+void DistributedSegment::join()
+{
+	while(running()) {
+		if(m_state == Local) m_local->join();
+		else wait(50);
+	}
+}
+
+const bool DistributedSegment::running() const
+{
+	// wait() lets the process and socket notice progress, update() acts on it
+	return const_cast<DistributedSegment*>(this)->update();
+}
+
+const bool DistributedSegment::parallel() const
+{
+	return true;
+}
+
+void DistributedSegment::finalize()
+{
+	if(m_state == Local) {
+		m_local->setSession(session());
+		m_local->finalize();
+		return;
+	}
+	session()->err()->write(m_err);
+}
+
+void DistributedSegment::wait(int msecs)
+{
+	switch(m_state) {
+	case Preprocessing:
+		if(m_preprocess->state() != QProcess::NotRunning) m_preprocess->waitForFinished(msecs);
+		break;
+	case Connecting:
+		// waitForConnected(0) gives up before looking at the socket
+		if(m_socket->state() == QAbstractSocket::ConnectingState) m_socket->waitForConnected(qMax(msecs, 1));
+		break;
+	case Remote:
+		if(m_socket->bytesToWrite() > 0) m_socket->waitForBytesWritten(msecs);
+		else if(m_socket->bytesAvailable() == 0) m_socket->waitForReadyRead(msecs);
+		break;
+	case Local:
+		m_local->wait(msecs);
+		break;
+	default:
+		break;
+	}
+}
+
+void DistributedSegment::cancel()
+{
+	m_cancelled = true;
+	switch(m_state) {
+	case Preprocessing:
+		killProcess(m_preprocess);
+		m_preprocess->waitForFinished(1000);
+		break;
+	case Connecting:
+	case Remote:
+		// The daemon kills the job when the connection goes away
+		m_socket->abort();
+		break;
+	case Local:
+		m_local->cancel();
+		releaseHost();
+		return;
+	default:
+		break;
+	}
+	releaseHost();
+	m_state = Done;
+}
+
+const bool DistributedSegment::remote() const
+{
+	return m_remote;
+}
+
+const bool DistributedSegment::update()
+{
+	switch(m_state) {
+	case Preprocessing:
+		if(m_preprocess->state() != QProcess::NotRunning) return true;
+		if(m_preprocess->exitStatus() != QProcess::NormalExit || m_preprocess->exitCode() != 0) {
+			// Compiling locally reports the errors exactly as a local build would
+			releaseHost();
+			runLocally();
+			return m_local->running();
+		}
+		if(!sendToHost()) {
+			m_pool->markDown(m_host);
+			releaseHost();
+			runLocally();
+			return m_local->running();
+		}
+		return true;
+	case Connecting:
+		if(m_socket->state() == QAbstractSocket::ConnectedState) {
+			qDebug() << "Compiling" << m_source << "on" << m_pool->host(m_host).address << m_pool->host(m_host).port;
+			m_socket->write(m_request);
+			m_request.clear();
+			m_state = Remote;
+			return true;
+		}
+		if(m_socket->state() != QAbstractSocket::UnconnectedState && !m_connectClock.hasExpired(CONNECT_MSECS)) return true;
+		m_pool->markDown(m_host);
+		releaseHost();
+		runLocally();
+		return m_local->running();
+	case Remote:
+		if(!readReply()) {
+			m_pool->markDown(m_host);
+			releaseHost();
+			runLocally();
+			return m_local->running();
+		}
+		return m_state == Remote;
+	case Local:
+		if(m_local->running()) return true;
+		releaseHost();
+		return false;
+	default:
+		return false;
+	}
+}
+
+const bool DistributedSegment::runLocally()
+{
+	m_state = Local;
+	m_err.clear();
+	return m_local->run();
+}
+
+const bool DistributedSegment::sendToHost()
+{
+	const QByteArray source = m_preprocess->readAllStandardOutput();
+	// #warning and friends are only reported while preprocessing
+	m_err = m_preprocess->readAllStandardError();
+
+	QStringList args;
+	foreach(const QString& flag, m_flags) {
+		if(DistributedProtocol::isRemoteArgument(flag)) args << flag;
+	}
+
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	stream << (quint8)DistributedProtocol::Compile << m_toolchain.family << m_toolchain.version << m_toolchain.machine
+		<< args << qCompress(source);
+	m_request = DistributedProtocol::frame(payload);
+
+	// The chain polls its other segments while this connects
+	const CompileHost& host = m_pool->host(m_host);
+	m_socket = new QTcpSocket();
+	m_socket->connectToHost(host.resolved, host.port);
+	m_connectClock.start();
+	m_state = Connecting;
+	return m_socket->state() != QAbstractSocket::UnconnectedState;
+}
+
+const bool DistributedSegment::readReply()
+{
+	m_buffer.append(m_socket->readAll());
+
+	QByteArray payload;
+	if(DistributedProtocol::oversized(m_buffer)) {
+		qWarning() << "Compile host sent an oversized reply for" << m_source;
+		return false;
+	}
+	if(!DistributedProtocol::takeFrame(m_buffer, payload)) {
+		return m_socket->state() == QAbstractSocket::ConnectedState;
+	}
+
+	QDataStream stream(payload);
+	quint8 type = 0;
+	stream >> type;
+	if(type == DistributedProtocol::Refused) {
+		QByteArray reason;
+		stream >> reason;
+		qWarning() << "Compile host refused" << m_source << ":" << reason;
+		return false;
+	}
+
+	bool crashed = false;
+	QByteArray object;
+	QByteArray err;
+	stream >> m_exitCode >> crashed >> object >> err;
+	if(type != DistributedProtocol::CompileReply || crashed) {
+		qWarning() << "Compile host failed to compile" << m_source << ":" << err;
+		return false;
+	}
+
+	if(m_exitCode == 0) {
+		QByteArray contents;
+		if(!DistributedProtocol::uncompress(object, contents)) {
+			qWarning() << "Compile host sent a malformed object for" << m_source;
+			return false;
+		}
+		QFile f(QDir(m_workingDirectory).absoluteFilePath(m_object));
+		if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(contents) < 0) {
+			qWarning() << "Unable to write" << f.fileName();
+			m_exitCode = -1;
+		}
+	}
+	m_err += err;
+
+	m_socket->disconnectFromHost();
+	releaseHost();
+	m_remote = true;
+	m_state = Done;
+	return true;
+}
+
+void DistributedSegment::releaseHost()
+{
+	if(!m_acquired) return;
+	m_pool->release(m_host);
+	m_acquired = false;
+}
+
+#pragma mark -
+#pragma mark CompileDaemon
+
+CompileDaemon::CompileDaemon(const QString& program, quint16 jobSlots, QObject* parent)
+	: QObject(parent), m_toolchain(ToolchainRegistry::identify(program)), m_jobSlots(jobSlots), m_server(new QTcpServer(this)),
+	m_nextJob(0), m_completed(0)
+{
+	if(!m_jobSlots) {
+		const int ideal = QThread::idealThreadCount();
+		m_jobSlots = ideal > 0 ? ideal : 1;
+	}
+	connect(m_server, SIGNAL(newConnection()), SLOT(newConnection()));
+}
+
+CompileDaemon::~CompileDaemon()
+{
+	foreach(Job* job, m_running) {
+		killProcess(job->process);
+		job->process->waitForFinished();
+		job->client = 0;
+		removeJob(job);
+	}
+	foreach(Job* job, m_queued) {
+		m_queued.removeAll(job);
+		removeJob(job);
+	}
+}
+
+const bool CompileDaemon::listen(const QHostAddress& address, quint16 port)
+{
+	if(!m_server->listen(address, port)) {
+		qWarning() << "Compile daemon unable to listen on port" << port << ":" << m_server->errorString();
+		return false;
+	}
+	qDebug() << "Compile daemon listening on" << address.toString() << "port" << m_server->serverPort()
+		<< "with" << m_jobSlots << "slots of" << m_toolchain.family << m_toolchain.version << m_toolchain.machine;
+	return true;
+}
+
+void CompileDaemon::setAllowed(const QList<QPair<QHostAddress, int> >& subnets)
+{
+	m_allowed = subnets;
+}
+
+quint16 CompileDaemon::port() const
+{
+	return m_server->serverPort();
+}
+
+quint32 CompileDaemon::completed() const
+{
+	return m_completed;
+}
+
+void CompileDaemon::newConnection()
+{
+	while(m_server->hasPendingConnections()) {
+		QTcpSocket* client = m_server->nextPendingConnection();
+		if(!isAllowed(client->peerAddress())) {
+			qWarning() << "Refusing compile client" << client->peerAddress().toString();
+			client->abort();
+			client->deleteLater();
+			continue;
+		}
+		m_buffers.insert(client, QByteArray());
+		connect(client, SIGNAL(readyRead()), SLOT(readClient()));
+		connect(client, SIGNAL(disconnected()), SLOT(clientDisconnected()));
+	}
+}
+
+void CompileDaemon::readClient()
+{
+	QTcpSocket* client = qobject_cast<QTcpSocket*>(sender());
+	if(!client || !m_buffers.contains(client)) return;
+
+	QByteArray& buffer = m_buffers[client];
+	buffer.append(client->readAll());
+	QByteArray payload;
+	while(DistributedProtocol::takeFrame(buffer, payload)) handleFrame(client, payload);
+	if(DistributedProtocol::oversized(buffer)) {
+		qWarning() << "Dropping compile client" << client->peerAddress().toString() << "that sent an oversized frame";
+		client->abort();
+		return;
+	}
+	startJobs();
+}
+
+void CompileDaemon::clientDisconnected()
+{
+	QTcpSocket* client = qobject_cast<QTcpSocket*>(sender());
+	if(!client) return;
+	m_buffers.remove(client);
+
+	foreach(Job* job, m_queued) {
+		if(job->client != client) continue;
+		m_queued.removeAll(job);
+		removeJob(job);
+	}
+	foreach(Job* job, m_running) {
+		if(job->client != client) continue;
+		job->client = 0;
+		killProcess(job->process);
+	}
+	client->deleteLater();
+}
+
+void CompileDaemon::handleFrame(QTcpSocket* client, const QByteArray& payload)
+{
+	QDataStream stream(payload);
+	quint8 type = 0;
+	stream >> type;
+
+	if(type == DistributedProtocol::Status) {
+		QByteArray status;
+		QDataStream statusStream(&status, QIODevice::WriteOnly);
+		statusStream << (quint8)DistributedProtocol::StatusReply << (quint32)m_jobSlots << load();
+		client->write(DistributedProtocol::frame(status));
+		return;
+	}
+	if(type != DistributedProtocol::Compile) {
+		qWarning() << "Unexpected compile daemon frame" << type;
+		return;
+	}
+
+	QString family;
+	QString version;
+	QString machine;
+	QStringList args;
+	QByteArray compressed;
+	stream >> family >> version >> machine >> args >> compressed;
+
+	// An object from another compiler or architecture would link wrong or not at all
+	if(m_toolchain.family.isEmpty() || family != m_toolchain.family || version != m_toolchain.version
+		|| machine != m_toolchain.machine) {
+		refuse(client, QString("Compiler is %1 %2 %3").arg(m_toolchain.family, m_toolchain.version, m_toolchain.machine).toUtf8());
+		return;
+	}
+	foreach(const QString& arg, args) {
+		if(DistributedProtocol::isRemoteArgument(arg)) continue;
+		refuse(client, "Refused argument " + arg.toUtf8());
+		return;
+	}
+	if(m_queued.size() >= m_jobSlots * COMPILE_DAEMON_QUEUE_PER_SLOT) {
+		refuse(client, "Too many queued jobs");
+		return;
+	}
+	QByteArray source;
+	if(!DistributedProtocol::uncompress(compressed, source)) {
+		refuse(client, "Malformed or oversized source");
+		return;
+	}
+
+	Job* job = new Job;
+	job->client = client;
+	job->process = 0;
+	job->args = args;
+	job->directory = QDir::temp().absoluteFilePath(QString("kiss-daemon-%1-%2")
+		.arg(QCoreApplication::applicationPid()).arg(m_nextJob++));
+
+	QDir().mkpath(job->directory);
+	QFile f(QDir(job->directory).absoluteFilePath(SOURCE_NAME));
+	if(!f.open(QIODevice::WriteOnly) || f.write(source) < 0) {
+		reply(job, -1, true, QByteArray(), "Unable to write " + f.fileName().toUtf8());
+		removeJob(job);
+		return;
+	}
+	f.close();
+	m_queued.append(job);
+}
+
+void CompileDaemon::reply(Job* job, qint32 exitCode, bool crashed, const QByteArray& object, const QByteArray& err)
+{
+	if(!job->client) return;
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	stream << (quint8)DistributedProtocol::CompileReply << exitCode << crashed << qCompress(object) << err;
+	job->client->write(DistributedProtocol::frame(payload));
+}
+
+void CompileDaemon::refuse(QTcpSocket* client, const QByteArray& reason)
+{
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	stream << (quint8)DistributedProtocol::Refused << reason;
+	client->write(DistributedProtocol::frame(payload));
+}
+
+const bool CompileDaemon::isAllowed(const QHostAddress& address) const
+{
+	if(m_allowed.isEmpty()) return true;
+	for(int i = 0; i < m_allowed.size(); ++i) {
+		if(address.isInSubnet(m_allowed[i])) return true;
+	}
+	return false;
+}
+
+void CompileDaemon::startJobs()
+{
+	while(m_running.size() < m_jobSlots && !m_queued.isEmpty()) {
+		Job* job = m_queued.takeFirst();
+		job->process = new QProcessSegmentProcess();
+		job->process->setWorkingDirectory(job->directory);
+		connect(job->process, SIGNAL(finished(int, QProcess::ExitStatus)), SLOT(jobFinished()));
+		connect(job->process, SIGNAL(error(QProcess::ProcessError)), SLOT(jobFinished()));
+		m_running.append(job);
+		job->process->start(m_toolchain.path, QStringList(job->args)
+			<< "-c" << "-x" << "cpp-output" << SOURCE_NAME << "-o" << OBJECT_NAME);
+	}
+}
+
+void CompileDaemon::jobFinished()
+{
+	QProcess* process = qobject_cast<QProcess*>(sender());
+	if(!process || process->state() != QProcess::NotRunning) return;
+
+	Job* job = 0;
+	foreach(Job* running, m_running) {
+		if(running->process == process) job = running;
+	}
+	if(!job) return;
+	m_running.removeAll(job);
+
+	const bool crashed = process->error() == QProcess::FailedToStart || process->exitStatus() == QProcess::CrashExit;
+	const qint32 exitCode = crashed ? -1 : process->exitCode();
+	QByteArray object;
+	if(exitCode == 0) {
+		QFile f(QDir(job->directory).absoluteFilePath(OBJECT_NAME));
+		if(f.open(QIODevice::ReadOnly)) object = f.readAll();
+	}
+	reply(job, exitCode, crashed, object, process->readAllStandardError());
+	++m_completed;
+	removeJob(job);
+	startJobs();
+}
+
+void CompileDaemon::removeJob(Job* job)
+{
+	if(job->process) {
+		job->process->disconnect(this);
+		job->process->deleteLater();
+	}
+	QDir dir(job->directory);
+	dir.remove(SOURCE_NAME);
+	dir.remove(OBJECT_NAME);
+	QDir().rmdir(job->directory);
+	delete job;
+}
+
+quint32 CompileDaemon::load() const
+{
+	quint32 ret = m_running.size() + m_queued.size();
+#ifdef Q_OS_UNIX
+	// Someone may be sitting at the machine
+	double average = 0.0;
+	if(getloadavg(&average, 1) == 1 && average > ret) ret = (quint32)(average + 0.5);
+#endif
+	return ret;
+}
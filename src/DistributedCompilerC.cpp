@@ -0,0 +1,37 @@
+#include "DistributedCompilerC.h"
+
+#include "DistributedCompile.h"
+#include "Compilation.h"
+
+#include <QDebug>
+
+CompileResult DistributedCompilerC::compile(Compilation* compilation, const QStringList& files)
+{
+	QString spec = compilation->settings().value(COMPILE_HOSTS_KEY);
+	if(spec.isEmpty()) spec = QString::fromLocal8Bit(qgetenv(COMPILE_HOSTS_ENV));
+	const QStringList hosts = CompileHostPool::parseHosts(spec);
+	if(hosts.isEmpty()) return TestCompilerC::compile(compilation, files);
+	
+	CompileHostPool* pool = new CompileHostPool(hosts, TestCompilerC::concurrency());
+	pool->refresh();
+	m_pools.setLocalData(pool);
+	CompileResult ret = TestCompilerC::compile(compilation, files);
+	m_pools.setLocalData(0);
+	return ret;
+}
+
+ChainSegment* DistributedCompilerC::createGccSegment(Compilation* compilation, const QStringList& args)
+{
+	ChainSegment* local = TestCompilerC::createGccSegment(compilation, args);
+	CompileHostPool* pool = m_pools.hasLocalData() ? m_pools.localData() : 0;
+	// Precompiled headers and anything else that isn't an object compile stays here
+	if(!pool || !args.contains("-c")) return local;
+	return new DistributedSegment(pool, local, compilation->toolchain(), outputDirectory().path(), args);
+}
+
+quint16 DistributedCompilerC::concurrency()
+{
+	CompileHostPool* pool = m_pools.hasLocalData() ? m_pools.localData() : 0;
+	if(!pool) return TestCompilerC::concurrency();
+	return qMin(pool->totalSlots(), (quint32)0xffff);
+}
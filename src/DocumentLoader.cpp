@@ -0,0 +1,174 @@
+#include "DocumentLoader.h"
+
+#include <Qsci/qsciscintilla.h>
+#include <Qsci/qscilexer.h>
+
+#include <QTextCodec>
+#include <QTextDecoder>
+#include <QElapsedTimer>
+#include <QDebug>
+
+// Bytes appended to the editor at a time
+#define LOAD_CHUNK_BYTES (256 * 1024)
+// How long to keep appending chunks before letting the event loop run
+#define LOAD_SLICE_MSECS 15
+
+#define MIB_LATIN1 4
+#define MIB_UTF8 106
+
+DocumentLoader::DocumentLoader(QsciScintilla* editor, QObject* parent)
+	: QObject(parent),
+	m_editor(editor),
+	m_map(0),
+	m_pos(0),
+	m_decoder(0),
+	m_loading(false),
+	m_readOnly(false)
+{
+	m_timer.setInterval(0);
+	connect(&m_timer, SIGNAL(timeout()), SLOT(loadChunks()));
+}
+
+DocumentLoader::~DocumentLoader()
+{
+	releaseData();
+	delete m_decoder;
+}
+
+const bool DocumentLoader::loadFile(const QString& path)
+{
+	releaseData();
+	m_file.setFileName(path);
+	if(!m_file.open(QIODevice::ReadOnly)) return false;
+	
+	QByteArray data;
+	const qint64 size = m_file.size();
+	if(size > 0) {
+		m_map = m_file.map(0, size);
+		if(m_map) data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_map), size);
+		// Not everything can be mapped, like files on some network shares
+		else data = m_file.readAll();
+	}
+	
+	start(data, QTextCodec::codecForLocale());
+	return true;
+}
+
+void DocumentLoader::load(const QByteArray& data)
+{
+	releaseData();
+	start(data, QTextCodec::codecForCStrings());
+}
+
+const bool DocumentLoader::isLoading() const
+{
+	return m_loading;
+}
+
+void DocumentLoader::finish()
+{
+	if(!m_loading) return;
+	while(m_pos < m_data.size()) appendChunk();
+	done();
+}
+
+void DocumentLoader::setLexer(QsciLexer* lexer)
+{
+	if(m_loading) m_lexer = lexer;
+	else m_editor->setLexer(lexer);
+}
+
+void DocumentLoader::loadChunks()
+{
+	QElapsedTimer timer;
+	timer.start();
+	while(m_pos < m_data.size() && timer.elapsed() < LOAD_SLICE_MSECS) appendChunk();
+	if(m_pos >= m_data.size()) done();
+}
+
+void DocumentLoader::start(const QByteArray& data, QTextCodec* codec)
+{
+	m_timer.stop();
+	m_data = data;
+	m_pos = 0;
+	
+	// A UTF-8 byte order mark isn't part of the text
+	if(m_data.startsWith("\xef\xbb\xbf")) m_pos = 3;
+	
+	// Scintilla stores either UTF-8 or Latin-1
+	delete m_decoder;
+	m_decoder = 0;
+	const int mib = codec ? codec->mibEnum() : MIB_LATIN1;
+	if(mib != (m_editor->isUtf8() ? MIB_UTF8 : MIB_LATIN1)) {
+		m_decoder = (codec ? codec : QTextCodec::codecForMib(MIB_LATIN1))->makeDecoder();
+	}
+	
+	if(!m_loading) {
+		m_readOnly = m_editor->isReadOnly();
+		m_lexer = m_editor->lexer();
+		m_loading = true;
+	}
+	if(m_editor->lexer()) m_editor->setLexer(0);
+	
+	m_editor->setReadOnly(false);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETUNDOCOLLECTION, 0UL);
+	m_editor->clear();
+	m_editor->SendScintilla(QsciScintilla::SCI_ALLOCATE, (unsigned long)m_data.size());
+	m_editor->setReadOnly(true);
+	
+	// The first screenful is there as soon as the tab is
+	if(m_pos < m_data.size()) appendChunk();
+	if(m_pos < m_data.size()) m_timer.start();
+	else done();
+}
+
+void DocumentLoader::appendChunk()
+{
+	const int size = qMin(LOAD_CHUNK_BYTES, m_data.size() - m_pos);
+	QByteArray converted;
+	const char* text = m_data.constData() + m_pos;
+	int length = size;
+	if(m_decoder) {
+		// The decoder carries characters split between chunks over to the next one
+		const QString decoded = m_decoder->toUnicode(text, size);
+		converted = m_editor->isUtf8() ? decoded.toUtf8() : decoded.toLatin1();
+		text = converted.constData();
+		length = converted.size();
+	}
+	m_pos += size;
+	
+	m_editor->setReadOnly(false);
+	m_editor->SendScintilla(QsciScintilla::SCI_APPENDTEXT, (unsigned long)length, text);
+	m_editor->setReadOnly(true);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETSAVEPOINT);
+}
+
+void DocumentLoader::done()
+{
+	m_timer.stop();
+	releaseData();
+	delete m_decoder;
+	m_decoder = 0;
+	m_loading = false;
+	
+	m_editor->setReadOnly(m_readOnly);
+	m_editor->SendScintilla(QsciScintilla::SCI_EMPTYUNDOBUFFER);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETUNDOCOLLECTION, 1UL);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETSAVEPOINT);
+	if(m_lexer) m_editor->setLexer(m_lexer);
+	m_lexer = 0;
+	
+	emit finished();
+}
+
+void DocumentLoader::releaseData()
+{
+	// m_data may point into the mapping
+	m_data.clear();
+	m_pos = 0;
+	if(m_map) {
+		m_file.unmap(m_map);
+		m_map = 0;
+	}
+	m_file.close();
+}
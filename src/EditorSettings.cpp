@@ -0,0 +1,131 @@
+#include "EditorSettings.h"
+
+#include <QSettings>
+
+namespace
+{
+	// Fonts shouldn't be constructed before the application is
+	EditorSettings* s_current = 0;
+}
+
+EditorSettings::EditorSettings()
+	: autoCompletion(false),
+	apiSource(false),
+	documentSource(false),
+	autoCompletionThreshold(4),
+	autoIndent(true),
+	maintainIndent(false),
+	indentWidth(4),
+	callTips(true),
+	braceMatching(true),
+	lineNumbers(true),
+	debuggerEnabled(false),
+	version(0)
+{
+#ifdef Q_OS_WIN32
+	font = QFont("Courier New", 10);
+#elif defined(Q_OS_MAC)
+	font = QFont("Monaco", 12);
+#else
+	font = QFont("Monospace", 10);
+#endif
+}
+
+const bool EditorSettings::operator==(const EditorSettings& rhs) const
+{
+	return font.family() == rhs.font.family()
+		&& font.pointSize() == rhs.font.pointSize()
+		&& autoCompletion == rhs.autoCompletion
+		&& apiSource == rhs.apiSource
+		&& documentSource == rhs.documentSource
+		&& autoCompletionThreshold == rhs.autoCompletionThreshold
+		&& autoIndent == rhs.autoIndent
+		&& maintainIndent == rhs.maintainIndent
+		&& indentWidth == rhs.indentWidth
+		&& callTips == rhs.callTips
+		&& braceMatching == rhs.braceMatching
+		&& lineNumbers == rhs.lineNumbers
+		&& debuggerEnabled == rhs.debuggerEnabled;
+}
+
+const bool EditorSettings::operator!=(const EditorSettings& rhs) const
+{
+	return !(*this == rhs);
+}
+
+const EditorSettings& EditorSettings::current()
+{
+	if(!s_current) {
+		s_current = new EditorSettings(read());
+		s_current->version = 1;
+	}
+	return *s_current;
+}
+
+void EditorSettings::publish(const EditorSettings& settings)
+{
+	settings.write();
+	
+	const EditorSettings& previous = current();
+	if(settings == previous) return;
+	const int version = previous.version + 1;
+	*s_current = settings;
+	s_current->version = version;
+}
+
+EditorSettings EditorSettings::read()
+{
+	EditorSettings ret;
+	QSettings settings;
+	settings.beginGroup(EDITOR);
+	ret.font = QFont(settings.value(FONT, ret.font.family()).toString(),
+		settings.value(FONT_SIZE, ret.font.pointSize()).toInt());
+	
+	settings.beginGroup(AUTO_COMPLETION);
+	ret.autoCompletion = settings.value(ENABLED, ret.autoCompletion).toBool();
+	ret.apiSource = settings.value(API_SOURCE, ret.apiSource).toBool();
+	ret.documentSource = settings.value(DOC_SOURCE, ret.documentSource).toBool();
+	ret.autoCompletionThreshold = settings.value(THRESHOLD, ret.autoCompletionThreshold).toInt();
+	settings.endGroup();
+	
+	settings.beginGroup(AUTO_INDENT);
+	ret.autoIndent = settings.value(ENABLED, ret.autoIndent).toBool();
+	ret.maintainIndent = settings.value(STYLE).toString() == MAINTAIN;
+	ret.indentWidth = settings.value(WIDTH, ret.indentWidth).toInt();
+	settings.endGroup();
+	
+	ret.callTips = settings.value(CALL_TIPS, ret.callTips).toBool();
+	ret.braceMatching = settings.value(BRACE_MATCHING, ret.braceMatching).toBool();
+	ret.lineNumbers = settings.value(LINE_NUMBERS, ret.lineNumbers).toBool();
+	ret.debuggerEnabled = settings.value(DEBUGGER_ENABLED, ret.debuggerEnabled).toBool();
+	settings.endGroup();
+	return ret;
+}
+
+void EditorSettings::write() const
+{
+	QSettings settings;
+	settings.beginGroup(EDITOR);
+	settings.setValue(FONT, font.family());
+	settings.setValue(FONT_SIZE, font.pointSize());
+	
+	settings.beginGroup(AUTO_COMPLETION);
+	settings.setValue(ENABLED, autoCompletion);
+	settings.setValue(API_SOURCE, apiSource);
+	settings.setValue(DOC_SOURCE, documentSource);
+	settings.setValue(THRESHOLD, autoCompletionThreshold);
+	settings.endGroup();
+	
+	settings.beginGroup(AUTO_INDENT);
+	settings.setValue(ENABLED, autoIndent);
+	settings.setValue(STYLE, maintainIndent ? MAINTAIN : INTELLIGENT);
+	settings.setValue(WIDTH, indentWidth);
+	settings.endGroup();
+	
+	settings.setValue(CALL_TIPS, callTips);
+	settings.setValue(BRACE_MATCHING, braceMatching);
+	settings.setValue(LINE_NUMBERS, lineNumbers);
+	settings.setValue(DEBUGGER_ENABLED, debuggerEnabled);
+	settings.endGroup();
+	settings.sync();
+}
@@ -0,0 +1,203 @@
+#include "FindInFiles.h"
+
+#include "Project.h"
+#include "QTinyArchive.h"
+
+#include <QRunnable>
+#include <QRegExp>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QDebug>
+
+// Matches found in a file before they're reported without waiting for the rest of it
+#define FIND_IN_FILES_BATCH 256
+
+class FindInFiles::Task : public QRunnable
+{
+public:
+	Task(FindInFiles* find, int search, const Source& source, const QString& query,
+		const bool regularExpression, const Qt::CaseSensitivity caseSensitivity)
+		: m_find(find), m_search(search), m_source(source), m_query(query),
+		m_regularExpression(regularExpression), m_caseSensitivity(caseSensitivity)
+	{
+	}
+	
+	virtual void run()
+	{
+		QByteArray data = m_source.data;
+		if(!m_source.project) {
+			QFile file(m_source.path);
+			if(file.open(QIODevice::ReadOnly)) data = file.readAll();
+		}
+		
+		// Binary files would only turn up noise
+		if(!data.contains('\0')) {
+			const QString text = QString::fromUtf8(data.constData(), data.size());
+			if(m_regularExpression) searchLines(text);
+			else search(text);
+		}
+		report();
+		QMetaObject::invokeMethod(m_find, "fileSearched", Qt::QueuedConnection, Q_ARG(int, m_search));
+	}
+	
+private:
+	const bool cancelled() const
+	{
+		return m_find->m_cancelled != 0;
+	}
+	
+	void search(const QString& text)
+	{
+		const QChar* chars = text.constData();
+		int line = 1;
+		int lineStart = 0;
+		int counted = 0;
+		int pos = text.indexOf(m_query, 0, m_caseSensitivity);
+		while(pos >= 0 && !cancelled()) {
+			// Lines are only counted up to each match
+			for(; counted < pos; ++counted) {
+				if(chars[counted] != '\n') continue;
+				++line;
+				lineStart = counted + 1;
+			}
+			int lineEnd = text.indexOf('\n', pos);
+			if(lineEnd < 0) lineEnd = text.size();
+			add(line, pos - lineStart, m_query.size(), text.mid(lineStart, lineEnd - lineStart));
+			pos = lineEnd < text.size() ? text.indexOf(m_query, lineEnd, m_caseSensitivity) : -1;
+		}
+	}
+	
+	void searchLines(const QString& text)
+	{
+		// Per line, so ^ and $ mean what they do in an editor
+		QRegExp expression(m_query, m_caseSensitivity);
+		int line = 1;
+		for(int lineStart = 0; lineStart < text.size() && !cancelled(); ++line) {
+			int lineEnd = text.indexOf('\n', lineStart);
+			if(lineEnd < 0) lineEnd = text.size();
+			const QString str = text.mid(lineStart, lineEnd - lineStart);
+			const int column = expression.indexIn(str);
+			if(column >= 0) add(line, column, expression.matchedLength(), str);
+			lineStart = lineEnd + 1;
+		}
+	}
+	
+	void add(int line, int column, int length, QString text)
+	{
+		if(text.endsWith('\r')) text.chop(1);
+		FindInFilesMatch match;
+		match.location = m_source.location;
+		match.project = m_source.project;
+		match.path = m_source.path;
+		match.line = line;
+		match.column = column;
+		match.length = length;
+		match.text = text;
+		m_matches << match;
+		if(m_matches.size() >= FIND_IN_FILES_BATCH) report();
+	}
+	
+	void report()
+	{
+		if(m_matches.isEmpty()) return;
+		QMetaObject::invokeMethod(m_find, "matchesFound", Qt::QueuedConnection,
+			Q_ARG(int, m_search), Q_ARG(FindInFilesMatchList, m_matches));
+		m_matches.clear();
+	}
+	
+	FindInFiles* m_find;
+	int m_search;
+	Source m_source;
+	QString m_query;
+	bool m_regularExpression;
+	Qt::CaseSensitivity m_caseSensitivity;
+	FindInFilesMatchList m_matches;
+};
+
+FindInFiles::FindInFiles(QObject* parent)
+	: QObject(parent),
+	m_cancelled(0),
+	m_search(0),
+	m_remaining(0)
+{
+	qRegisterMetaType<FindInFilesMatchList>("FindInFilesMatchList");
+}
+
+FindInFiles::~FindInFiles()
+{
+	// Tasks refer to this
+	m_cancelled.fetchAndStoreOrdered(1);
+	m_pool.waitForDone();
+}
+
+void FindInFiles::addProject(Project* project)
+{
+	const QTinyArchive* archive = project->archive();
+	foreach(const QString& path, archive->files()) {
+		Source source;
+		source.location = project->name() + ": " + path;
+		source.project = project;
+		source.path = path;
+		source.data = QTinyNode::data(archive->lookup(path));
+		m_sources << source;
+	}
+}
+
+void FindInFiles::addFile(const QString& path)
+{
+	Source source;
+	source.location = QFileInfo(path).absoluteFilePath();
+	source.project = 0;
+	source.path = source.location;
+	m_sources << source;
+}
+
+const bool FindInFiles::start(const QString& query, const bool regularExpression, const bool caseSensitive)
+{
+	cancel();
+	const Qt::CaseSensitivity caseSensitivity = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+	if(query.isEmpty() || (regularExpression && !QRegExp(query, caseSensitivity).isValid())) {
+		m_sources.clear();
+		return false;
+	}
+	
+	m_cancelled.fetchAndStoreOrdered(0);
+	++m_search;
+	m_remaining = m_sources.size();
+	foreach(const Source& source, m_sources) {
+		Task* task = new Task(this, m_search, source, query, regularExpression, caseSensitivity);
+		m_pool.start(task);
+	}
+	m_sources.clear();
+	
+	if(!m_remaining) emit finished(false);
+	return true;
+}
+
+void FindInFiles::cancel()
+{
+	if(!isRunning()) return;
+	m_cancelled.fetchAndStoreOrdered(1);
+	m_pool.waitForDone();
+	// What's still queued belongs to this search
+	++m_search;
+	m_remaining = 0;
+	emit finished(true);
+}
+
+const bool FindInFiles::isRunning() const
+{
+	return m_remaining > 0;
+}
+
+void FindInFiles::matchesFound(int search, const FindInFilesMatchList& matches)
+{
+	if(search == m_search) emit found(matches);
+}
+
+void FindInFiles::fileSearched(int search)
+{
+	if(search != m_search || --m_remaining > 0) return;
+	emit finished(false);
+}
@@ -0,0 +1,157 @@
+#include "FindInFilesTab.h"
+
+#include "MainWindow.h"
+#include "SourceFile.h"
+#include "Project.h"
+#include "ProjectManager.h"
+#include "QTinyArchive.h"
+
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QTreeView>
+#include <QHeaderView>
+#include <QStandardItemModel>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+// Past this many matches the search stops. Nobody reads further.
+#define FIND_IN_FILES_MAX_MATCHES 10000
+
+FindInFilesTab::FindInFilesTab(MainWindow* parent)
+	: QWidget(parent), TabbedWidget(this, parent),
+	m_truncated(false),
+	m_query(new QLineEdit(this)),
+	m_regularExpression(new QCheckBox(tr("Regular Expression"), this)),
+	m_matchCase(new QCheckBox(tr("Match Case"), this)),
+	m_search(new QPushButton(tr("Search"), this)),
+	m_status(new QLabel(this)),
+	m_results(new QTreeView(this)),
+	m_model(new QStandardItemModel(this))
+{
+	QHBoxLayout* options = new QHBoxLayout();
+	options->addWidget(new QLabel(tr("Find:"), this));
+	options->addWidget(m_query);
+	options->addWidget(m_regularExpression);
+	options->addWidget(m_matchCase);
+	options->addWidget(m_search);
+	
+	QVBoxLayout* layout = new QVBoxLayout(this);
+	layout->addLayout(options);
+	layout->addWidget(m_results);
+	layout->addWidget(m_status);
+	
+	m_model->setHorizontalHeaderLabels(QStringList() << tr("File") << tr("Line") << tr("Text"));
+	m_results->setModel(m_model);
+	m_results->setRootIsDecorated(false);
+	m_results->setUniformRowHeights(true);
+	m_results->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_results->header()->setStretchLastSection(true);
+	
+	connect(m_query, SIGNAL(returnPressed()), SLOT(search()));
+	connect(m_search, SIGNAL(clicked()), SLOT(search()));
+	connect(m_results, SIGNAL(activated(QModelIndex)), SLOT(open(QModelIndex)));
+	connect(&m_find, SIGNAL(found(FindInFilesMatchList)), SLOT(found(FindInFilesMatchList)));
+	connect(&m_find, SIGNAL(finished(bool)), SLOT(finished(bool)));
+}
+
+void FindInFilesTab::activate()
+{
+	mainWindow()->setTitle(tr("Find in Files"));
+	mainWindow()->hideErrors();
+	m_query->setFocus(Qt::OtherFocusReason);
+}
+
+bool FindInFilesTab::beginSetup() { return true; }
+void FindInFilesTab::completeSetup() { mainWindow()->setTabName(this, tr("Find in Files")); }
+
+bool FindInFilesTab::close()
+{
+	m_find.cancel();
+	return true;
+}
+
+void FindInFilesTab::refreshSettings() {}
+
+void FindInFilesTab::search()
+{
+	// The same button stops a search
+	if(m_find.isRunning()) {
+		m_find.cancel();
+		return;
+	}
+	
+	m_model->removeRows(0, m_model->rowCount());
+	m_matches.clear();
+	m_truncated = false;
+	
+	foreach(Project* project, ProjectManager::ref().projects()) m_find.addProject(project);
+	foreach(SourceFile* sourceFile, mainWindow()->tabs<SourceFile>()) {
+		if(sourceFile->isProjectAssociated() || sourceFile->isNewFile() || !sourceFile->isFileAssociated()) continue;
+		m_find.addFile(sourceFile->associatedFile());
+	}
+	
+	if(!m_find.start(m_query->text(), m_regularExpression->isChecked(), m_matchCase->isChecked())) {
+		m_status->setText(m_query->text().isEmpty() ? QString() : tr("Invalid regular expression"));
+		return;
+	}
+	if(m_find.isRunning()) {
+		m_search->setText(tr("Stop"));
+		updateStatus(tr("Searching..."));
+	}
+}
+
+void FindInFilesTab::found(const FindInFilesMatchList& matches)
+{
+	foreach(const FindInFilesMatch& match, matches) {
+		if(m_matches.size() >= FIND_IN_FILES_MAX_MATCHES) {
+			m_truncated = true;
+			m_find.cancel();
+			return;
+		}
+		m_matches << match;
+		QList<QStandardItem*> row;
+		row << new QStandardItem(match.location);
+		row << new QStandardItem(QString::number(match.line));
+		row << new QStandardItem(match.text.trimmed());
+		m_model->appendRow(row);
+	}
+	updateStatus(tr("Searching..."));
+}
+
+void FindInFilesTab::finished(const bool cancelled)
+{
+	m_search->setText(tr("Search"));
+	if(m_truncated) updateStatus(tr("Stopped after %1 matches").arg(FIND_IN_FILES_MAX_MATCHES));
+	else updateStatus(cancelled ? tr("Cancelled") : tr("Done"));
+	m_results->resizeColumnToContents(0);
+}
+
+void FindInFilesTab::open(const QModelIndex& index)
+{
+	if(!index.isValid() || index.row() >= m_matches.size()) return;
+	const FindInFilesMatch& match = m_matches[index.row()];
+	
+	SourceFile* sourceFile = 0;
+	if(match.project) {
+		// The project may have been closed since
+		if(!ProjectManager::ref().projects().contains(match.project)) return;
+		const TinyNode* node = match.project->archive()->lookup(match.path);
+		if(!node) return;
+		sourceFile = mainWindow()->openProjectFile(match.project, node);
+	} else if(mainWindow()->openFile(match.path)) {
+		foreach(SourceFile* tab, mainWindow()->tabs<SourceFile>()) {
+			if(tab->associatedFile() == match.path) sourceFile = tab;
+		}
+	}
+	if(!sourceFile) return;
+	
+	sourceFile->moveTo(match.line, match.column);
+	sourceFile->editor()->setFocus(Qt::OtherFocusReason);
+}
+
+void FindInFilesTab::updateStatus(const QString& state)
+{
+	m_status->setText(tr("%1 - %2 matches").arg(state).arg(m_matches.size()));
+}
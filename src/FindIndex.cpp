@@ -0,0 +1,268 @@
+#include "FindIndex.h"
+
+#include <Qsci/qsciscintilla.h>
+
+#include <QColor>
+#include <QtAlgorithms>
+
+#include <cstring>
+
+namespace
+{
+	const char* find(const char* from, const char* end, char c)
+	{
+		const void* ret = memchr(from, c, end - from);
+		return ret ? static_cast<const char*>(ret) : end;
+	}
+	
+	char asciiLower(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+	
+	char asciiUpper(char c)
+	{
+		return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+	}
+}
+
+FindIndex::FindIndex(QsciScintilla* editor, QObject* parent)
+	: QObject(parent),
+	m_editor(editor),
+	m_indicator(editor->indicatorDefine(QsciScintilla::RoundBoxIndicator)),
+	m_caseSensitive(true),
+	m_scintilla(false),
+	m_replacing(false)
+{
+	m_editor->setIndicatorForegroundColor(QColor(0xff, 0xb0, 0x00), m_indicator);
+	
+	connect(m_editor, SIGNAL(SCN_MODIFIED(int, int, const char*, int, int, int, int, int, int, int)),
+		SLOT(modified(int, int, const char*, int, int, int, int, int, int, int)));
+}
+
+void FindIndex::setQuery(const QString& text, const bool caseSensitive)
+{
+	m_caseSensitive = caseSensitive;
+	m_scintilla = false;
+	m_needle = encode(caseSensitive ? text : text.toLower());
+	if(!caseSensitive) {
+		foreach(const char c, m_needle) {
+			if(!(c & 0x80)) continue;
+			m_scintilla = true;
+			m_needle = encode(text);
+			break;
+		}
+	}
+	reindex();
+}
+
+void FindIndex::clear()
+{
+	m_needle.clear();
+	reindex();
+}
+
+int FindIndex::count() const
+{
+	return m_matches.size();
+}
+
+int FindIndex::matchStart(int match) const
+{
+	return m_matches[match];
+}
+
+int FindIndex::matchLength() const
+{
+	return m_needle.size();
+}
+
+int FindIndex::matchAfter(int pos) const
+{
+	if(m_matches.isEmpty()) return -1;
+	const int ret = qLowerBound(m_matches.constBegin(), m_matches.constEnd(), pos) - m_matches.constBegin();
+	return ret < m_matches.size() ? ret : 0;
+}
+
+const bool FindIndex::isMatch(int start, int end) const
+{
+	if(m_needle.isEmpty() || end - start != m_needle.size()) return false;
+	return qBinaryFind(m_matches.constBegin(), m_matches.constEnd(), start) != m_matches.constEnd();
+}
+
+const bool FindIndex::replaceSelection(const QString& replacement)
+{
+	const int start = m_editor->SendScintilla(QsciScintilla::SCI_GETSELECTIONSTART);
+	const int end = m_editor->SendScintilla(QsciScintilla::SCI_GETSELECTIONEND);
+	if(!isMatch(start, end)) return false;
+	
+	const QByteArray with = encode(replacement);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETSTART, start);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETEND, end);
+	m_editor->SendScintilla(QsciScintilla::SCI_REPLACETARGET, with.size(), with.constData());
+	m_editor->SendScintilla(QsciScintilla::SCI_GOTOPOS, start + with.size());
+	return true;
+}
+
+int FindIndex::replaceAll(const QString& replacement)
+{
+	QVector<int> replaced;
+	int previousEnd = 0;
+	foreach(const int match, m_matches) {
+		if(match < previousEnd) continue;
+		replaced << match;
+		previousEnd = match + m_needle.size();
+	}
+	if(replaced.isEmpty()) return 0;
+	
+	// Bottom up, so the positions of matches still to be replaced stay valid
+	const QByteArray with = encode(replacement);
+	m_replacing = true;
+	m_editor->SendScintilla(QsciScintilla::SCI_BEGINUNDOACTION);
+	for(int i = replaced.size() - 1; i >= 0; --i) {
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETSTART, replaced[i]);
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETEND, replaced[i] + m_needle.size());
+		m_editor->SendScintilla(QsciScintilla::SCI_REPLACETARGET, with.size(), with.constData());
+	}
+	m_editor->SendScintilla(QsciScintilla::SCI_ENDUNDOACTION);
+	m_replacing = false;
+	
+	reindex();
+	return replaced.size();
+}
+
+void FindIndex::modified(int position, int modificationType, const char*, int length, int,
+	int, int, int, int, int)
+{
+	if(m_needle.isEmpty() || m_replacing) return;
+	if(!(modificationType & (QsciScintilla::SC_MOD_INSERTTEXT | QsciScintilla::SC_MOD_DELETETEXT))) return;
+	
+	// Undoing a replace all changes every match. Reindexing once is cheaper.
+	if(modificationType & QsciScintilla::SC_MULTISTEPUNDOREDO) {
+		if(modificationType & QsciScintilla::SC_LASTSTEPINUNDOREDO) reindex();
+		return;
+	}
+	
+	const int n = m_needle.size();
+	const int inserted = modificationType & QsciScintilla::SC_MOD_INSERTTEXT ? length : 0;
+	const int removed = modificationType & QsciScintilla::SC_MOD_DELETETEXT ? length : 0;
+	
+	// Matches overlapping the change are gone, later ones move with the text
+	QVector<int>::iterator first = qLowerBound(m_matches.begin(), m_matches.end(), position - n + 1);
+	QVector<int>::iterator last = qLowerBound(first, m_matches.end(), position + removed);
+	for(QVector<int>::iterator it = last; it != m_matches.end(); ++it) *it += inserted - removed;
+	const int index = first - m_matches.begin();
+	m_matches.erase(first, last);
+	
+	// New matches can only start in the inserted text or just before the change
+	const int start = qMax(position - n + 1, 0);
+	const QVector<int> found = searchRange(start, position + inserted);
+	if(!found.isEmpty()) m_matches = m_matches.mid(0, index) + found + m_matches.mid(index);
+	highlight(start, position + inserted + n - 1);
+}
+
+void FindIndex::search(const char* text, int base, int length, QVector<int>* matches) const
+{
+	const int n = m_needle.size();
+	if(length < n) return;
+	
+	// memchr is vectorized by the C library, so candidates are found a word or more at a time.
+	// Without case, the first character is looked for both ways.
+	const char* end = text + length - n + 1;
+	const char first = m_needle[0];
+	const char other = m_caseSensitive ? first : asciiUpper(first);
+	const char* a = find(text, end, first);
+	const char* b = other != first ? find(text, end, other) : end;
+	for(;;) {
+		const char* c = qMin(a, b);
+		if(c == end) break;
+		if(matchesAt(c)) matches->append(base + (c - text));
+		if(c == a) a = find(c + 1, end, first);
+		if(c == b) b = find(c + 1, end, other);
+	}
+}
+
+void FindIndex::searchScintilla(int start, int end, QVector<int>* matches) const
+{
+	// This runs from modified() in the middle of SCI_REPLACETARGET, which reads the
+	// target again to insert its text. The target and flags have to be left as found.
+	const int targetStart = m_editor->SendScintilla(QsciScintilla::SCI_GETTARGETSTART);
+	const int targetEnd = m_editor->SendScintilla(QsciScintilla::SCI_GETTARGETEND);
+	const int searchFlags = m_editor->SendScintilla(QsciScintilla::SCI_GETSEARCHFLAGS);
+	
+	m_editor->SendScintilla(QsciScintilla::SCI_SETSEARCHFLAGS, 0UL);
+	while(start < end) {
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETSTART, start);
+		m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETEND, end);
+		const int found = m_editor->SendScintilla(QsciScintilla::SCI_SEARCHINTARGET,
+			(unsigned long)m_needle.size(), m_needle.constData());
+		if(found < 0) break;
+		matches->append(found);
+		start = found + 1;
+	}
+	
+	m_editor->SendScintilla(QsciScintilla::SCI_SETSEARCHFLAGS, (unsigned long)searchFlags);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETSTART, targetStart);
+	m_editor->SendScintilla(QsciScintilla::SCI_SETTARGETEND, targetEnd);
+}
+
+QVector<int> FindIndex::searchRange(int start, int end) const
+{
+	QVector<int> ret;
+	if(m_needle.isEmpty()) return ret;
+	
+	// A match starting before end may run past it
+	const int length = m_editor->SendScintilla(QsciScintilla::SCI_GETLENGTH);
+	const int textEnd = qMin(end + m_needle.size() - 1, length);
+	if(textEnd - start < m_needle.size()) return ret;
+	
+	if(m_scintilla) searchScintilla(start, textEnd, &ret);
+	else if(start == 0 && textEnd == length) {
+		// The buffer itself, once Scintilla has moved its gap out of the way
+		const char* text = reinterpret_cast<const char*>(m_editor->SendScintilla(QsciScintilla::SCI_GETCHARACTERPOINTER));
+		search(text, 0, length, &ret);
+	} else {
+		// Copying a little text is cheaper than moving the gap away from the caret
+		QByteArray text(textEnd - start + 1, '\0');
+		m_editor->SendScintilla(QsciScintilla::SCI_GETTEXTRANGE, start, textEnd, text.data());
+		search(text.constData(), start, textEnd - start, &ret);
+	}
+	return ret;
+}
+
+const bool FindIndex::matchesAt(const char* text) const
+{
+	const int n = m_needle.size();
+	if(m_caseSensitive) return !memcmp(text, m_needle.constData(), n);
+	for(int i = 0; i < n; ++i) if(asciiLower(text[i]) != m_needle[i]) return false;
+	return true;
+}
+
+void FindIndex::reindex()
+{
+	const int length = m_editor->SendScintilla(QsciScintilla::SCI_GETLENGTH);
+	m_matches = searchRange(0, length);
+	highlight(0, length);
+}
+
+void FindIndex::highlight(int start, int end)
+{
+	start = qMax(start, 0);
+	end = qMin(end, (int)m_editor->SendScintilla(QsciScintilla::SCI_GETLENGTH));
+	if(end <= start) return;
+	
+	m_editor->SendScintilla(QsciScintilla::SCI_SETINDICATORCURRENT, m_indicator);
+	m_editor->SendScintilla(QsciScintilla::SCI_INDICATORCLEARRANGE, start, end - start);
+	
+	// Matches starting before the range may still reach into it
+	const int n = m_needle.size();
+	QVector<int>::const_iterator it = qLowerBound(m_matches.constBegin(), m_matches.constEnd(), start - n + 1);
+	for(; it != m_matches.constEnd() && *it < end; ++it) {
+		m_editor->SendScintilla(QsciScintilla::SCI_INDICATORFILLRANGE, *it, n);
+	}
+}
+
+QByteArray FindIndex::encode(const QString& text) const
+{
+	return m_editor->isUtf8() ? text.toUtf8() : text.toLatin1();
+}
@@ -3,60 +3,269 @@
 #include "ErrorWidget.h"
 
 #include <QIODevice>
+#include <QScriptEngine>
+#include <QScriptValue>
+#include <QDebug>
 
-#define ERROR_KEY "error"
-#define LINKER_KEY "linker"
-#define WARNING_KEY "warning"
+#include <cstring>
 
-CompileResult GccOutput::processCompilerOutput(QIODevice* in)
+namespace
 {
-	bool foundError = false;
-	bool foundWarning = false;
+	inline bool isDigit(const char c)
+	{
+		return c >= '0' && c <= '9';
+	}
 	
-	QStringList errorMessages;
-	QStringList warningMessages;
-	QStringList verboseMessages;
-
-	while(in->canReadLine()) {
-		QString input = QString::fromLocal8Bit(in->readLine());
-		QString output;
-
-		input.remove(QRegExp("\\r*\\n$"));
+	inline bool isAlpha(const char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+	
+	int parseNumber(const char*& p, const char* end)
+	{
+		int ret = 0;
+		for(; p < end && isDigit(*p); ++p) ret = ret * 10 + (*p - '0');
+		return ret;
+	}
+	
+	bool consume(const char*& p, const char* end, const char* word)
+	{
+		const int len = strlen(word);
+		if(end - p < len || memcmp(p, word, len)) return false;
+		p += len;
+		return true;
+	}
+	
+	// Recognizes "file:line[:column]: severity: message" (line and column are optional)
+	bool parseLine(const char* begin, const char* end, Diagnostic& diag)
+	{
+		const char* p = begin;
+		
+		// Skip a Windows drive letter so its colon isn't taken as the file separator
+		if(end - p > 2 && isAlpha(p[0]) && p[1] == ':' && (p[2] == '\\' || p[2] == '/')) p += 2;
+		
+		const char* fileEnd = static_cast<const char*>(memchr(p, ':', end - p));
+		if(!fileEnd || fileEnd == begin) return false;
+		
+		p = fileEnd + 1;
+		int line = 0;
+		int column = 0;
+		if(p < end && isDigit(*p)) {
+			line = parseNumber(p, end);
+			if(p >= end || *p != ':') return false;
+			++p;
+			if(p < end && isDigit(*p)) {
+				const char* columnStart = p;
+				column = parseNumber(p, end);
+				if(p < end && *p == ':') ++p;
+				else {
+					p = columnStart;
+					column = 0;
+				}
+			}
+		}
+		
+		while(p < end && *p == ' ') ++p;
+		
+		Diagnostic::Severity severity;
+		if(consume(p, end, "error:") || consume(p, end, "fatal error:")) severity = Diagnostic::Error;
+		else if(consume(p, end, "warning:")) severity = Diagnostic::Warning;
+		else if(consume(p, end, "note:")) severity = Diagnostic::Note;
+		else return false;
+		
+		while(p < end && *p == ' ') ++p;
+		
+		diag.file = QString::fromLocal8Bit(begin, fileEnd - begin);
+		diag.line = line;
+		diag.column = column;
+		diag.severity = severity;
+		diag.message = QString::fromLocal8Bit(p, end - p);
+		return true;
+	}
+	
+	Diagnostic::Severity severityFromKind(const QString& kind)
+	{
+		if(kind.startsWith("warning")) return Diagnostic::Warning;
+		if(kind == "note") return Diagnostic::Note;
+		return Diagnostic::Error;
+	}
+	
+	// gcc's finish column is inclusive, as is Diagnostic::endColumn
+	void readLocation(const QScriptValue& locations, QString& file, int& line, int& column, int* endLine = 0, int* endColumn = 0)
+	{
+		if(locations.property("length").toInt32() < 1) return;
+		const QScriptValue location = locations.property(0);
+		const QScriptValue caret = location.property("caret");
+		file = caret.property("file").toString();
+		line = caret.property("line").toInt32();
+		column = caret.property("column").toInt32();
+		
+		const QScriptValue finish = location.property("finish");
+		if(!finish.isObject()) return;
+		if(endLine) *endLine = finish.property("line").toInt32();
+		if(endColumn) *endColumn = finish.property("column").toInt32();
+	}
+	
+	Diagnostic diagnosticFromJson(const QScriptValue& value)
+	{
+		Diagnostic ret;
+		ret.severity = severityFromKind(value.property("kind").toString());
+		ret.message = value.property("message").toString();
+		readLocation(value.property("locations"), ret.file, ret.line, ret.column, &ret.endLine, &ret.endColumn);
+		
+		const QScriptValue children = value.property("children");
+		const int childCount = children.property("length").toInt32();
+		for(int i = 0; i < childCount; ++i) {
+			const QScriptValue child = children.property(i);
+			DiagnosticNote note;
+			note.message = child.property("message").toString();
+			readLocation(child.property("locations"), note.file, note.line, note.column);
+			ret.notes.append(note);
+		}
+		
+		const QScriptValue fixits = value.property("fixits");
+		const int fixitCount = fixits.property("length").toInt32();
+		for(int i = 0; i < fixitCount; ++i) {
+			const QScriptValue fixit = fixits.property(i);
+			DiagnosticFixit f;
+			f.line = fixit.property("start").property("line").toInt32();
+			f.column = fixit.property("start").property("column").toInt32();
+			f.endLine = fixit.property("next").property("line").toInt32();
+			f.endColumn = fixit.property("next").property("column").toInt32();
+			f.replacement = fixit.property("string").toString();
+			ret.fixits.append(f);
+		}
+		
+		return ret;
+	}
+}
 
-		verboseMessages << input;
+DiagnosticList GccOutput::parseCompilerOutput(const QByteArray& data)
+{
+	DiagnosticList ret;
+	QStringList pending;
+	
+	const char* p = data.constData();
+	const char* const end = p + data.size();
+	while(p < end) {
+		const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		if(!eol) eol = end;
+		const char* lineEnd = eol;
+		while(lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+		
+		Diagnostic diag;
+		if(parseLine(p, lineEnd, diag)) {
+			if(diag.severity == Diagnostic::Note && !ret.isEmpty()) {
+				DiagnosticNote note;
+				note.file = diag.file;
+				note.line = diag.line;
+				note.column = diag.column;
+				note.message = diag.message;
+				ret.last().notes.append(note);
+			} else {
+				diag.context = pending;
+				pending.clear();
+				ret.append(diag);
+			}
+		} else if(lineEnd > p) {
+			// Indented lines (source excerpts, carets) belong to the previous diagnostic,
+			// anything else ("In function ...", "In file included from ...") to the next
+			const QString line = QString::fromLocal8Bit(p, lineEnd - p);
+			if((*p == ' ' || *p == '\t') && !ret.isEmpty()) ret.last().context.append(line);
+			else pending.append(line);
+		}
+		
+		p = eol + 1;
+	}
+	
+	// Lines after the last diagnostic ("cc1: some warnings being treated as errors",
+	// "/usr/bin/ld: ...") have nothing to go before, so they stay with what they follow
+	if(!ret.isEmpty()) ret.last().context += pending;
+	
+	return ret;
+}
 
-		input.remove(QRegExp("^C\\:"));
-		input.remove(QRegExp("^/.*/(?=\\S*\\:)"));
+DiagnosticList GccOutput::parseJsonCompilerOutput(const QByteArray& data, QByteArray* nonJson)
+{
+	DiagnosticList ret;
+	QScriptEngine engine;
+	QScriptValue parse = engine.globalObject().property("JSON").property("parse");
+	
+	// Every gcc invocation prints its diagnostics as a single JSON array on one line
+	int start = 0;
+	while(start < data.size()) {
+		int eol = data.indexOf('\n', start);
+		if(eol < 0) eol = data.size();
+		const QByteArray rawLine = data.mid(start, eol - start);
+		const QByteArray line = rawLine.trimmed();
+		start = eol + 1;
+		if(line.isEmpty()) continue;
+		
+		if(!line.startsWith('[')) {
+			if(nonJson) *nonJson += rawLine + "\n";
+			continue;
+		}
+		
+		const QScriptValue array = parse.call(QScriptValue(), QScriptValueList() << QString::fromUtf8(line));
+		if(engine.hasUncaughtException() || !array.isArray()) {
+			qWarning() << "Unable to parse gcc JSON diagnostics:" << engine.uncaughtException().toString();
+			engine.clearExceptions();
+			if(nonJson) *nonJson += line + "\n";
+			continue;
+		}
+		
+		const int length = array.property("length").toInt32();
+		for(int i = 0; i < length; ++i) ret.append(diagnosticFromJson(array.property(i)));
+	}
+	
+	return ret;
+}
 
-		output += input.section(':',0,0) + ":";
+CompileResult GccOutput::processCompilerOutput(QIODevice* in)
+{
+	const QByteArray data = in->readAll();
+	QString raw = QString::fromLocal8Bit(data);
+	raw.remove('\r');
+	if(raw.endsWith('\n')) raw.chop(1);
+	return compileResult(parseCompilerOutput(data), raw);
+}
 
-		if(input.section(':',2,2).length() > 0) {
-			output += input.section(':',1,1) + ":";
-			output += input.section(':',2,2).remove(' ') + ":";
-			output += input.section(':', 3);
-		} else output += input.section(':', 1);
+CompileResult GccOutput::processJsonCompilerOutput(QIODevice* in)
+{
+	QByteArray text;
+	DiagnosticList diagnostics = parseJsonCompilerOutput(in->readAll(), &text);
+	diagnostics += parseCompilerOutput(text);
+	
+	// The JSON itself is useless to read, so rebuild gcc's familiar text form for the raw view
+	QStringList raw;
+	foreach(const Diagnostic& diag, diagnostics) {
+		raw << diag.toString();
+		foreach(const DiagnosticNote& note, diag.notes) raw << note.toString();
+	}
+	return compileResult(diagnostics, raw.join("\n"));
+}
 
-		if(output.section(':', 2, 2) == ERROR_KEY) {
-			errorMessages << output;
-			foundError = true;
-		} else if(output.section(':', 2, 2) == WARNING_KEY) {
-			warningMessages << output;
-			foundWarning = true;
-		} else {
-			errorMessages << input;
-			warningMessages << input;
-		}
+CompileResult GccOutput::compileResult(const DiagnosticList& diagnostics, const QString& raw)
+{
+	QStringList errorMessages;
+	QStringList warningMessages;
+	foreach(const Diagnostic& diag, diagnostics) {
+		QStringList* messages = 0;
+		if(diag.severity == Diagnostic::Error) messages = &errorMessages;
+		else if(diag.severity == Diagnostic::Warning) messages = &warningMessages;
+		if(!messages) continue;
+		
+		messages->append(diag.toString());
+		foreach(const DiagnosticNote& note, diag.notes) messages->append(note.toString());
 	}
 	
-	if(!foundError && !foundWarning) warningMessages.clear();
-	else if(!foundError) errorMessages.clear();
-	else if(!foundWarning) warningMessages.clear();
-	
 	QMap<QString, QStringList> ret;
-	if(foundError) ret[DEFAULT_ERROR_KEY] = errorMessages;
-	if(foundWarning) ret[DEFAULT_WARNING_KEY] = warningMessages;
+	if(!errorMessages.isEmpty()) ret[DEFAULT_ERROR_KEY] = errorMessages;
+	if(!warningMessages.isEmpty()) ret[DEFAULT_WARNING_KEY] = warningMessages;
 	
-	return CompileResult(true, ret, verboseMessages.join("\n"));
+	CompileResult result(true, ret, raw);
+	result.setDiagnostics(diagnostics);
+	return result;
 }
 
 CompileResult GccOutput::processLinkerOutput(QIODevice* in)
@@ -75,4 +284,3 @@ CompileResult GccOutput::processLinkerOutput(QIODevice* in)
 	
 	return CompileResult(true, ret, verboseMessages.join("\n"));
 }
-
@@ -33,6 +33,7 @@
 #include "Project.h"
 #include "ProjectSettingsTab.h"
 #include "ProjectManager.h"
+#include "FindInFilesTab.h"
 #include "QTinyArchive.h"
 #include "Log.h"
 
@@ -81,6 +82,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), m_currentTab(0),
 	deleteTab(0);
 
 	hideErrors();
+	connect(ui_errors, SIGNAL(diagnosticActivated(QString, int, int)), SLOT(diagnosticActivated(QString, int, int)));
 	
 	//connect(ui_projects, SIGNAL(clicked(const QModelIndex&)), SLOT(projectFileClicked(const QModelIndex&)));
 	connect(ui_projects, SIGNAL(doubleClicked(const QModelIndex&)), SLOT(projectClicked(const QModelIndex&)));
@@ -605,6 +607,18 @@ void MainWindow::errorClicked(QListWidgetItem* item)
 #endif
 }
 
+void MainWindow::diagnosticActivated(const QString& file, int line, int column)
+{
+	const QString path = QDir::cleanPath(QFileInfo(file).absoluteFilePath());
+	foreach(SourceFile* sourceFile, tabs<SourceFile>()) {
+		if(sourceFile->compiledPath() != path) continue;
+		ui_tabWidget->setCurrentWidget(sourceFile);
+		sourceFile->moveTo(line, column > 0 ? column - 1 : 0);
+		sourceFile->editor()->setFocus(Qt::OtherFocusReason);
+		return;
+	}
+}
+
 void MainWindow::addLookup(TabbedWidget* tab)
 {
 	if(lookup(tab->widget())) return;
@@ -643,27 +657,38 @@ void MainWindow::projectClicked(const QModelIndex& index)
 		addTab(tab);
 	} else if(m_projectsModel.indexType(index) == ProjectsModel::FileType) {
 		qDebug() << "File!!";
-		const TinyNode* node = m_projectsModel.indexToNode(index);
-		const QString& file = QString::fromStdString(node->path());
 		if(!project) return;
+		openProjectFile(project, m_projectsModel.indexToNode(index));
+	}
+}
 
-		SourceFile* sourceFile = new SourceFile(this);
-		for(int i = 0; i < ui_tabWidget->count(); ++i) {
-			SourceFile* sourceFile = dynamic_cast<SourceFile*>(ui_tabWidget->widget(i));
-			if(sourceFile && sourceFile->associatedFile() == file) {
-				ui_tabWidget->setCurrentIndex(i);
-				on_ui_tabWidget_currentChanged(i);
-				return;
-			}
+SourceFile* MainWindow::openProjectFile(Project* project, const TinyNode* node)
+{
+	const QString& file = QString::fromStdString(node->path());
+	for(int i = 0; i < ui_tabWidget->count(); ++i) {
+		SourceFile* sourceFile = dynamic_cast<SourceFile*>(ui_tabWidget->widget(i));
+		if(sourceFile && sourceFile->associatedFile() == file) {
+			ui_tabWidget->setCurrentIndex(i);
+			on_ui_tabWidget_currentChanged(i);
+			return sourceFile;
 		}
+	}
 
-		if(!sourceFile->openProjectFile(project, node)) {
-			delete sourceFile;
-			return;
-		}
-		Log::ref().debug(QString("Opened %1 for editing").arg(node->name()));
-		addTab(sourceFile);
+	SourceFile* sourceFile = new SourceFile(this);
+	if(!sourceFile->openProjectFile(project, node)) {
+		delete sourceFile;
+		return 0;
 	}
+	Log::ref().debug(QString("Opened %1 for editing").arg(node->name()));
+	addTab(sourceFile);
+	return sourceFile;
+}
+
+void MainWindow::findInFiles()
+{
+	QList<FindInFilesTab*> open = tabs<FindInFilesTab>();
+	if(open.isEmpty()) addTab(new FindInFilesTab(this));
+	else moveToTab(open[0]);
 }
 
 void MainWindow::projectFileClicked(const QModelIndex& index)
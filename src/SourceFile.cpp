@@ -41,6 +41,11 @@
 #include "Log.h"
 #include "Compiler.h"
 #include "Compilation.h"
+#include "CompilationService.h"
+#include "BlockIndenter.h"
+#include "DocumentLoader.h"
+#include "BuildProfile.h"
+#include "BuildProfileTab.h"
 
 #include "UiEventManager.h"
 #include "ResourceHelper.h"
@@ -67,15 +72,12 @@
 #include <QUrl>
 #include <Qsci/qscilexercpp.h>
 
-#include <memory>
-
 #define SAVE_PATH "savepath"
 #define DEFAULT_EXTENSION "default_extension"
 
-#define MAX(a, b) (a > b ? a : b)
 
 SourceFile::SourceFile(MainWindow* parent) : QWidget(parent), TabbedWidget(this, parent), WorkingUnit("File"), m_isNewFile(true),
-	m_debuggerEnabled(false), m_runTab(0), m_debugger(parent)
+	m_lexer(0), m_settingsVersion(0), m_marginDigits(0), m_debuggerEnabled(false), m_compilation(0), m_runTab(0), m_debugger(parent)
 {
 	setupUi(this);
 	
@@ -92,9 +94,25 @@ SourceFile::SourceFile(MainWindow* parent) : QWidget(parent), TabbedWidget(this,
 	
 	mainWindow()->setStatusMessage("");
 	
-	connect(ui_editor, SIGNAL(textChanged()), this, SLOT(updateMargins()));
+	// The margin only needs to grow or shrink when the line count gains or loses a digit
+	connect(ui_editor, SIGNAL(linesChanged()), this, SLOT(linesChanged()));
+	connect(ui_editor, SIGNAL(SCN_ZOOM()), this, SLOT(updateMargins()));
 	connect(ui_editor, SIGNAL(modificationChanged(bool)), this, SLOT(sourceModified(bool)));
 	
+	m_loader = new DocumentLoader(ui_editor, this);
+	connect(m_loader, SIGNAL(finished()), SLOT(updateMargins()));
+	
+	m_indenter = new BlockIndenter(ui_editor, this);
+	connect(ui_editor, SIGNAL(SCN_CHARADDED(int)), this, SLOT(autoIndent(int)));
+	
+	CompilationService* compilationService = &CompilationService::ref();
+	connect(compilationService, SIGNAL(unitStarted(Compilation*, QString, QStringList)),
+		SLOT(compilationUnitStarted(Compilation*, QString, QStringList)));
+	connect(compilationService, SIGNAL(unitFinished(Compilation*, CompileResult)),
+		SLOT(compilationUnitFinished(Compilation*, CompileResult)));
+	connect(compilationService, SIGNAL(compilationFinished(Compilation*, bool)),
+		SLOT(compilationFinished(Compilation*, bool)));
+	
 	ui_find->hide();
 	ui_localCompileFailed->hide();
 	
@@ -105,6 +123,12 @@ SourceFile::SourceFile(MainWindow* parent) : QWidget(parent), TabbedWidget(this,
 	refreshSettings();
 }
 
+SourceFile::~SourceFile()
+{
+	ui_editor->setLexer(0);
+	Lexer::Factory::ref().release(m_lexer);
+}
+
 void SourceFile::activate()
 {
 	mainWindow()->setTitle(target()->name() + (!target()->port().isEmpty() ? (" - " + target()->port()) : ""));
@@ -163,6 +187,7 @@ bool SourceFile::save()
 bool SourceFile::fileSaveAs(const QString& filePath)
 {
 	if(filePath.isEmpty()) return false;
+	m_loader->finish();
 	
 	ui_editor->convertEols(QsciScintilla::EolUnix);
 	if(ui_editor->text(ui_editor->lines() - 1).length() > 0) ui_editor->append("\n");
@@ -192,7 +217,7 @@ bool SourceFile::fileSaveAs(const QString& filePath)
 	
 	// Update the lexer to the new spec for that extension
 	Lexer::Constructor* constructor = Lexer::Factory::ref().constructor(associatedFileSuffix());
-	if(Lexer::Factory::isLexerFromConstructor((Lexer::LexerBase*)ui_editor->lexer(), constructor))
+	if(Lexer::Factory::isLexerFromConstructor(m_lexer, constructor))
 		setLexer(constructor);
 	
 	return true;
@@ -202,22 +227,15 @@ bool SourceFile::fileOpen(const QString& filePath)
 {
 	setAssociatedFile(filePath);
 	
-	QFile fileHandle(associatedFile());
-	
-	if(!fileHandle.open(QIODevice::ReadOnly)) return false;
-
-	QTextStream fileStream(&fileHandle);
-	ui_editor->setText(fileStream.readAll());
-	fileHandle.close();
-
-	ui_editor->setModified(false);
+	// Large files keep loading in the background
+	if(!m_loader->loadFile(associatedFile())) return false;
 
 	m_isNewFile = false;
 
 	mainWindow()->setTabName(this, associatedFileName());
 
 	Lexer::Constructor* constructor = Lexer::Factory::ref().constructor(associatedFileSuffix());
-	if(Lexer::Factory::isLexerFromConstructor((Lexer::LexerBase*)ui_editor->lexer(), constructor))
+	if(Lexer::Factory::isLexerFromConstructor(m_lexer, constructor))
 		setLexer(constructor);
 	
 	setAssociatedProject(0);
@@ -229,15 +247,13 @@ bool SourceFile::memoryOpen(const QByteArray& ba, const QString& assocPath)
 {
 	setAssociatedFile(assocPath);
 	
-	ui_editor->setText(ba);
-
-	ui_editor->setModified(false);
+	m_loader->load(ba);
 	m_isNewFile = false;
 
 	mainWindow()->setTabName(this, associatedFileName());
 
 	Lexer::Constructor* constructor = Lexer::Factory::ref().constructor(associatedFileSuffix());
-	if(Lexer::Factory::isLexerFromConstructor((Lexer::LexerBase*)ui_editor->lexer(), constructor))
+	if(Lexer::Factory::isLexerFromConstructor(m_lexer, constructor))
 		setLexer(constructor);
 		
 	return true;
@@ -253,60 +269,24 @@ bool SourceFile::openProjectFile(Project* project, const TinyNode* node)
 
 void SourceFile::indentAll()
 {
-	if(!ui_editor->lexer()) return;
 	if(!target()->cStyleBlocks()) return;
-	
-	setUpdatesEnabled(false);
-
-	int indentLevel = 0;
-	int blockStartStyle; ui_editor->lexer()->blockStart(&blockStartStyle);
-	int blockEndStyle; ui_editor->lexer()->blockEnd(&blockEndStyle);
-	
-	int currentLine;
-	int currentIndex;
-
-	ui_editor->getCursorPosition(&currentLine,&currentIndex);
-	ui_editor->append(" ");
-
-	QString outDocument;
-
-	for(int i = 0, pos = 0; i < ui_editor->lines(); ++i) {
-		// Get the current line of text and iterate through it looking for blockStart/End chars
-		QString line = ui_editor->text(i);
-		int blockStartCount = 0, blockEndCount = 0;
+	m_indenter->indentAll();
+}
 
-		for(int j = 0;j < line.length();j++,pos++) {
-			int style = ui_editor->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, pos);
-			//Increase the indentLevel on blockStart
-			if(style == blockStartStyle && line.at(j) == *ui_editor->lexer()->blockStart())
-				blockStartCount++;
-			//Decrease the indentLevel on blockEnd
-			if(style == blockEndStyle && line.at(j) == *ui_editor->lexer()->blockEnd())
-				blockEndCount++;
-		}
-		//The logic here is confusing, but the idea is either a newline is
-		//	of the default style (I can't think of a case other than a comment in which it would not be)
-		//	or it is a comment, but the end of a one line comment so the next line would be a different style
-		//  also, if the indentLevel > 0, we should indent anyway
-		if(blockEndCount > blockStartCount) {
-			indentLevel -= blockEndCount-blockStartCount;
-			blockEndCount = blockStartCount = 0;
-		}
-		if((ui_editor->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, pos-1) == ui_editor->lexer()->defaultStyle() ||
-			ui_editor->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, pos-1) 
-				!= ui_editor->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, pos)) || indentLevel)
-			outDocument += QString(line).replace(QRegExp("^[ \\t]*"), QString(indentLevel,'\t'));
-		else
-			outDocument += line;
-		indentLevel += blockStartCount-blockEndCount;
-	}
-	
-	outDocument.chop(1);
-	ui_editor->setText(outDocument + "\n");
+void SourceFile::autoIndent(int character)
+{
+	// QScintilla has already indented the line the way it knows how. This
+	// corrects it from the block depth, which costs only the lines edited since.
+	if(!ui_editor->autoIndent() || !ui_editor->lexer() || !target()->cStyleBlocks()) return;
+	if(ui_editor->lexer()->autoIndentStyle() & QsciScintilla::AiMaintain) return;
 	
-	ui_editor->setCursorPosition(currentLine, currentIndex);
+	const char* blockEnd = ui_editor->lexer()->blockEnd();
+	if(character != '\n' && character != '\r' && (!blockEnd || character != *blockEnd)) return;
 	
-	setUpdatesEnabled(true);
+	int line;
+	int index;
+	ui_editor->getCursorPosition(&line, &index);
+	m_indenter->indentLine(line);
 }
 
 void SourceFile::keyPressEvent(QKeyEvent *event)
@@ -372,79 +352,116 @@ void SourceFile::keyPressEvent(QKeyEvent *event)
 
 void SourceFile::refreshSettings()
 {
-	/* Read font, indent, margin, etc. settings */
-	QSettings settings;
-	settings.beginGroup(EDITOR);
-
-	/* Set the default font from settings */
-	QFont defFont(settings.value(FONT).toString(), settings.value(FONT_SIZE).toInt());
+	// Tabs are refreshed for every change, but only need to apply each version once
+	const EditorSettings& settings = EditorSettings::current();
+	if(settings.version == m_settingsVersion) return;
+	m_settingsVersion = settings.version;
+	
+	applyLexerSettings();
+	
+	ui_editor->setAutoIndent(settings.autoIndent);
+	ui_editor->setTabWidth(settings.indentWidth);
 	
-	if(ui_editor->lexer()) ui_editor->lexer()->setFont(defFont, -1);
-	Lexer::Factory::ref().setFont(defFont);
-
-	/* Set other options from settings */
-	settings.beginGroup(AUTO_INDENT);
-	ui_editor->setAutoIndent(settings.value(ENABLED).toBool());
-	if(ui_editor->lexer()) ui_editor->lexer()->setAutoIndentStyle(settings.value(STYLE).toString() == MAINTAIN ? 
-		QsciScintilla::AiMaintain : 0);
-	ui_editor->setTabWidth(settings.value(WIDTH).toInt());
-	settings.endGroup();
-
-	settings.beginGroup(AUTO_COMPLETION);
 	ui_editor->setAutoCompletionSource(QsciScintilla::AcsNone);
-	if(settings.value(ENABLED).toBool()) {
-		if(settings.value(API_SOURCE).toBool()) ui_editor->setAutoCompletionSource(QsciScintilla::AcsAPIs);
-		if(settings.value(DOC_SOURCE).toBool()) {
+	if(settings.autoCompletion) {
+		if(settings.apiSource) ui_editor->setAutoCompletionSource(QsciScintilla::AcsAPIs);
+		if(settings.documentSource) {
 			if(ui_editor->autoCompletionSource() == QsciScintilla::AcsAPIs)
 				ui_editor->setAutoCompletionSource(QsciScintilla::AcsAll);
 			else ui_editor->setAutoCompletionSource(QsciScintilla::AcsDocument);
 		}
 	}
-	ui_editor->setAutoCompletionThreshold(settings.value(THRESHOLD).toInt());
-	settings.endGroup();
+	ui_editor->setAutoCompletionThreshold(settings.autoCompletionThreshold);
 
-	ui_editor->setMarginLineNumbers(0, settings.value(LINE_NUMBERS).toBool());
+	ui_editor->setMarginLineNumbers(0, settings.lineNumbers);
 	
 	ui_editor->setMarginLineNumbers(1, false);
 	
-	ui_editor->setBraceMatching(settings.value(BRACE_MATCHING).toBool() ? QsciScintilla::StrictBraceMatch : 
+	ui_editor->setBraceMatching(settings.braceMatching ? QsciScintilla::StrictBraceMatch : 
 		QsciScintilla::NoBraceMatch);
 	
-	ui_editor->setCallTipsStyle(settings.value(CALL_TIPS).toBool() ? QsciScintilla::CallTipsNoContext : 
+	ui_editor->setCallTipsStyle(settings.callTips ? QsciScintilla::CallTipsNoContext : 
 		QsciScintilla::CallTipsNone);
 		
-	m_debuggerEnabled = settings.value(DEBUGGER_ENABLED).toBool();
-
-	settings.endGroup();
-	
-	ui_editor->setLexer(ui_editor->lexer());
+	m_debuggerEnabled = settings.debuggerEnabled;
 	
 	updateMargins();
 	ui_editor->setMarginsBackgroundColor(QColor(Qt::white));
+}
+
+void SourceFile::applyLexerSettings()
+{
+	const EditorSettings& settings = EditorSettings::current();
 	
-	TargetMenu::ref().refresh();
+	// Restyles the lexers shared by all tabs
+	Lexer::Factory::ref().setFont(settings.font);
+	// Other tabs may still share this lexer, so a new indent style means another one
+	if(m_lexer && m_lexer->lexer()->autoIndentStyle() != lexerIndentStyle()) setLexer(m_lexer->constructor());
+}
+
+int SourceFile::lexerIndentStyle()
+{
+	return EditorSettings::current().maintainIndent ? QsciScintilla::AiMaintain : 0;
 }
 
 bool SourceFile::isNewFile() 	{ return m_isNewFile; }
 
 void SourceFile::updateMargins()
 {
+	m_marginDigits = lineDigits(ui_editor->lines());
 	int size = 0;
 	if(ui_editor->marginLineNumbers(0)) {
-		int charWidth = 6;
-		if(ui_editor->lexer()) {
-			QFont font = ui_editor->lexer()->defaultFont();
-			font.setPointSize(font.pointSize() + getZoom());
-			charWidth = QFontMetrics(font).width("0");
-		}
-		size = charWidth + charWidth/2 + charWidth * (int)ceil(log10(MAX(ui_editor->lines(), 10) + 1));
+		const int charWidth = digitWidth();
+		size = charWidth + charWidth/2 + charWidth * m_marginDigits;
 	}
 	ui_editor->setMarginWidth(0, size);
 	ui_editor->setMarginWidth(1, 16);
 }
 
+void SourceFile::linesChanged()
+{
+	if(lineDigits(ui_editor->lines()) != m_marginDigits) updateMargins();
+}
+
+int SourceFile::lineDigits(int lines)
+{
+	// Room for two digits at least
+	int ret = 2;
+	for(int n = lines / 100; n > 0; n /= 10) ++ret;
+	return ret;
+}
+
+int SourceFile::digitWidth()
+{
+	QsciLexer* lexer = ui_editor->lexer();
+	if(!lexer) return 6;
+	
+	const QFont font = lexer->defaultFont();
+	if(font != m_marginFont) {
+		m_marginFont = font;
+		m_digitWidths.clear();
+	}
+	
+	const int zoom = getZoom();
+	QMap<int, int>::const_iterator it = m_digitWidths.find(zoom);
+	if(it != m_digitWidths.end()) return it.value();
+	
+	QFont zoomed = font;
+	zoomed.setPointSize(font.pointSize() + zoom);
+	const int ret = QFontMetrics(zoomed).width("0");
+	m_digitWidths.insert(zoom, ret);
+	return ret;
+}
+
 int SourceFile::getZoom() { return ui_editor->SendScintilla(QsciScintilla::SCI_GETZOOM); }
-void SourceFile::moveTo(int line, int pos)  { if(line > 0 && pos >= 0) ui_editor->setCursorPosition(line - 1, pos); }
+void SourceFile::moveTo(int line, int pos)
+{
+	if(line <= 0 || pos < 0) return;
+	// The line may not have been loaded yet
+	m_loader->finish();
+	ui_editor->setCursorPosition(line - 1, pos);
+}
+
 QsciScintilla* SourceFile::editor() { return ui_editor; }
 int SourceFile::currentLine() const { return m_currentLine; }
 
@@ -461,9 +478,9 @@ SourceFile* SourceFile::newProjectFile(MainWindow* mainWindow, Project* project)
 	sourceFile->setAssociatedProject(project);
 }
 
-void SourceFile::zoomIn() { ui_editor->zoomIn(); updateMargins(); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_IN); }
-void SourceFile::zoomOut() { ui_editor->zoomOut(); updateMargins(); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_OUT); }
-void SourceFile::zoomReset() { ui_editor->zoomTo(0); updateMargins(); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_RESET); }
+void SourceFile::zoomIn() { ui_editor->zoomIn(); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_IN); }
+void SourceFile::zoomOut() { ui_editor->zoomOut(); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_OUT); }
+void SourceFile::zoomReset() { ui_editor->zoomTo(0); UiEventManager::ref().sendEvent(UI_EVENT_ZOOM_RESET); }
 
 bool SourceFile::saveAs()
 {
@@ -534,7 +551,7 @@ bool SourceFile::saveAsProject()
 	return fileSaveAs(path);
 }
 
-void SourceFile::sourceModified(bool) { mainWindow()->setTabName(this, "* " + associatedFileName()
+void SourceFile::sourceModified(bool modified) { mainWindow()->setTabName(this, (modified ? "* " : "") + associatedFileName()
 	+ (isProjectAssociated() ? (QString(" (") + associatedProject()->name() + ")") : QString())); }
 
 void SourceFile::download()
@@ -565,17 +582,73 @@ void SourceFile::compile()
 	
 	if(isProjectAssociated()) ProjectManager::ref().archiveWriter(associatedProject())->write(ArchiveWriter::Delta);
 	
-	std::auto_ptr<Compilation> compilation(isProjectAssociated()
+	m_compilation = isProjectAssociated()
 		? new Compilation(CompilerManager::ref().compilers(), associatedProject())
-		: new Compilation(CompilerManager::ref().compilers(), associatedFile()));
-	bool success = compilation->start();
+		: new Compilation(CompilerManager::ref().compilers(), associatedFile());
+	m_partialResults.clear();
+	
+	mainWindow()->setStatusMessage(tr("Compiling..."));
+	
+	// Pressing compile again replaces whatever this file or project was still building.
+	// Projects are told apart by identity since students' projects often share a name.
+	const QString key = isProjectAssociated()
+		? QString("project:%1").arg((quintptr)associatedProject(), 0, 16)
+		: associatedFile();
+	CompilationService::ref().submit(m_compilation, key, CompilationService::Supersede);
+}
+
+void SourceFile::compilationUnitStarted(Compilation* compilation, const QString& compiler, const QStringList& files)
+{
+	if(compilation != m_compilation) return;
+	QStringList names;
+	foreach(const QString& file, files) names << QFileInfo(file).fileName();
+	mainWindow()->setStatusMessage(tr("Compiling %1 with %2...").arg(names.join(", ")).arg(compiler));
+}
+
+void SourceFile::compilationUnitFinished(Compilation* compilation, const CompileResult& partial)
+{
+	if(!isCompiledBy(compilation)) return;
+	
+	// Another editor of this project started the compile and shows its errors, this one only marks its own lines
+	if(compilation != m_compilation) {
+		markProblems(partial, false);
+		return;
+	}
+	
+	m_partialResults += partial;
+	if(partial.diagnostics().isEmpty() && partial.categorizedOutput().isEmpty()) return;
+	mainWindow()->setErrors(topLevelUnit(), m_partialResults);
+	markProblems(partial, false);
+}
+
+void SourceFile::compilationFinished(Compilation* compilation, bool success)
+{
+	if(!isCompiledBy(compilation)) return;
+	
+	// A cancelled compilation didn't get to report everything, so its markers would wrongly clear the old ones
+	const bool cancelled = compilation->isCancelled() || compilation->results().cancelled();
+	if(compilation != m_compilation) {
+		if(!cancelled) markProblems(compilation->results(), true);
+		return;
+	}
+	
+	m_compilation = 0;
+	m_partialResults.clear();
+	
 	qDebug() << "Results:" << compilation->compileResults();
 	mainWindow()->setErrors(topLevelUnit(), compilation->results());
+	if(!cancelled) markProblems(compilation->results(), true);
 	
-	mainWindow()->setStatusMessage(success ? tr("Compile Succeeded") : tr("Compile Failed"));
+	if(cancelled) mainWindow()->setStatusMessage(tr("Compile Cancelled"));
+	else mainWindow()->setStatusMessage(success ? tr("Compile Succeeded") : tr("Compile Failed"));
 	
 	updateErrors();
 	
+	BuildProfile* profile = compilation->profile();
+	if(profile && !compilation->results().cancelled()) {
+		mainWindow()->addTab(new BuildProfileTab(compilation->name(), profile->report(), profile->tracePath(), mainWindow()));
+	}
+	
 	UiEventManager::ref().sendEvent(UI_EVENT_COMPILE);
 }
 
@@ -737,6 +810,7 @@ void SourceFile::makeTemplate()
 	// Write the template with metadata to output
 	TemplateFormatWriter writer(&outputStream);
 	writer.setLexerName(makeTemplateDialog.extension());
+	m_loader->finish();
 	writer.setContent(ui_editor->text());
 	writer.update();
 	
@@ -785,37 +859,61 @@ bool SourceFile::checkPort()
 	return true;
 }
 
-void SourceFile::setLexer(Lexer::Constructor* constructor)
+void SourceFile::setLexer(const Lexer::Constructor* constructor)
 {
-	delete ui_editor->lexer();
-	Lexer::LexerBase* lex = constructor->construct();
-	ui_editor->setLexer(lex->lexer());
-	Lexer::Factory::setAPIsForLexer(lex, m_lexAPI);
-	refreshSettings();
+	Lexer::LexerBase* previous = m_lexer;
+	m_lexer = Lexer::Factory::ref().acquire(constructor, m_lexAPI, lexerIndentStyle());
+	m_loader->setLexer(m_lexer ? m_lexer->lexer() : 0);
+	Lexer::Factory::ref().release(previous);
+	applyLexerSettings();
 	updateMargins();
 }
 
 void SourceFile::dropEvent(QDropEvent *event) { Q_UNUSED(event); }
 
-void SourceFile::clearProblems()
-{
-	ui_editor->markerDeleteAll(m_errorIndicator);
-	ui_editor->markerDeleteAll(m_warningIndicator);
-}
-
-void SourceFile::markProblems(const QStringList& errors, const QStringList& warnings)
+void SourceFile::markProblems(const CompileResult& results, const bool removeStale)
 {
-	foreach(const QString& error, errors) {
-		int line = error.section(":", 1, 1).toInt();
-		if(--line < 0) continue;
-		ui_editor->markerAdd(line, m_errorIndicator);
+	const int indicators[] = { m_errorIndicator, m_warningIndicator };
+	const unsigned mask = (1U << m_errorIndicator) | (1U << m_warningIndicator);
+	
+	QMap<int, unsigned> wanted;
+	foreach(const Diagnostic& diag, results.diagnosticsForFile(compiledPath())) {
+		if(diag.line <= 0 || diag.severity == Diagnostic::Note) continue;
+		wanted[diag.line - 1] |= 1U << (diag.severity == Diagnostic::Error ? m_errorIndicator : m_warningIndicator);
 	}
 	
-	foreach(const QString& warning, warnings) {
-		int line = warning.section(":", 1, 1).toInt();
-		if(--line < 0) continue;
-		ui_editor->markerAdd(line, m_warningIndicator);
+	// Markers move with the text, so the lines they are on now are what the new set is compared against
+	QMap<int, unsigned> current;
+	int line = ui_editor->markerFindNext(0, mask);
+	while(line >= 0) {
+		current[line] = ui_editor->markersAtLine(line) & mask;
+		line = ui_editor->markerFindNext(line + 1, mask);
 	}
+	
+	QMap<int, unsigned>::const_iterator it = wanted.constBegin();
+	for(; it != wanted.constEnd(); ++it) {
+		const unsigned missing = it.value() & ~current.value(it.key());
+		for(int i = 0; i < 2; ++i) if(missing & (1U << indicators[i])) ui_editor->markerAdd(it.key(), indicators[i]);
+	}
+	
+	// Partial results only ever add to what the rest of the compile will report
+	if(!removeStale) return;
+	for(it = current.constBegin(); it != current.constEnd(); ++it) {
+		const unsigned stale = it.value() & ~wanted.value(it.key());
+		for(int i = 0; i < 2; ++i) if(stale & (1U << indicators[i])) ui_editor->markerDelete(it.key(), indicators[i]);
+	}
+}
+
+const bool SourceFile::isCompiledBy(Compilation* compilation)
+{
+	if(compilation == m_compilation) return true;
+	return isProjectAssociated() && compilation->project() == associatedProject();
+}
+
+QString SourceFile::compiledPath()
+{
+	ArchiveWriter* writer = isProjectAssociated() ? ProjectManager::ref().archiveWriter(associatedProject()) : 0;
+	return QDir::cleanPath(writer ? writer->root().absoluteFilePath(associatedFile()) : associatedFileInfo().absoluteFilePath());
 }
 
 void SourceFile::updateErrors() 
@@ -909,7 +1007,7 @@ bool SourceFile::changeTarget(bool _template)
 	m_lexAPI = QString(targetPath).replace(QString(".") + TARGET_EXT, ".api");
 	
 	if(constructor) setLexer(constructor);
-	refreshSettings();
+	TargetMenu::ref().refresh();
 	
 	qDebug() << "changeTarget complete";
 	
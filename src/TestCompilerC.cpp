@@ -5,10 +5,24 @@
 #include "Temporary.h"
 
 #include "GccOutput.h"
+#include "Toolchain.h"
+#include "BuildProfile.h"
 
 #include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
+#include <QCryptographicHash>
+#include <QRegExp>
+#include <QMutex>
 #include <QDebug>
 
+#define PCH_DIRECTORY "pch"
+#define UNITY_DIRECTORY "unity"
+#define DEFAULT_UNITY_BATCH_SIZE 8
+
+// Compilations running at the same time may need the same header. Only one builds it.
+static QMutex precompiledHeaderMutex;
+
 TestCompilerC::TestCompilerC()
 	: Compiler("gcc", QStringList() << "c")
 {
@@ -17,15 +31,32 @@ TestCompilerC::TestCompilerC()
 
 CompileResult TestCompilerC::compile(Compilation* compilation, const QStringList& files)
 {
-	int idealProcesses = QThread::idealThreadCount();
-	CommandChain chain(idealProcesses > 0 ? idealProcesses : 1);
-	QStringList cFlags = compilation->settings()["C_FLAGS"].split(" ");
+	QStringList cFlags = compilation->settings()["C_FLAGS"].split(" ", QString::SkipEmptyParts);
+	const bool jsonDiagnostics = compilation->toolchain().hasFeature(TOOLCHAIN_JSON_DIAGNOSTICS);
+	if(jsonDiagnostics) cFlags << "-fdiagnostics-format=json";
+	if(compilation->profile()) cFlags << BuildProfile::flags(compilation->toolchain());
+	
+	QStringList unitFlags = cFlags;
+	const QString pch = precompiledHeader(compilation, files, cFlags);
+	if(!pch.isEmpty()) unitFlags << "-include" << pch << "-Winvalid-pch";
+	
+	if(compilation->settings().value(UNITY_BUILD_KEY) == "true" && files.size() > 1) {
+		return compileUnity(compilation, files, unitFlags, jsonDiagnostics);
+	}
+	return compileUnits(compilation, files, unitFlags, jsonDiagnostics);
+}
+
+CompileResult TestCompilerC::compileUnits(Compilation* compilation, const QStringList& files, const QStringList& flags, bool json)
+{
+	CommandChain chain(concurrency());
+	compilation->setupChain(&chain);
 	foreach(const QString& file, files) {
 		QFileInfo fi(file);
 		QString output = fi.path() + "/" + fi.baseName();
 		output = output.replace("/", "_");
 		output += ".o";
-		chain.add(createGccSegment(QStringList(cFlags) << "-c" << file << "-o" << output));
+		chain.add(createUnitSegment(compilation, QStringList(flags) << "-c" << file << "-o" << output,
+			fi.fileName(), "compile", output));
 		compilation->addFile(outputDirectory().path() + "/" + output);
 	}
 	bool success = chain.execute();
@@ -36,26 +67,257 @@ CompileResult TestCompilerC::compile(Compilation* compilation, const QStringList
 	if(!success) {
 		qWarning() << "Chain execution failed";
 	} else qWarning() << "Chain execution succeeded";
-	return CompileResult(success) + GccOutput::processCompilerOutput(err);
+	CompileResult result(success);
+	result.setCancelled(chain.cancelled() || chain.timedOut());
+	return result + processOutput(err, json);
+}
+
+CompileResult TestCompilerC::compileUnity(Compilation* compilation, const QStringList& files, const QStringList& flags, bool json)
+{
+	int batchSize = compilation->settings().value(UNITY_BATCH_SIZE_KEY).toInt();
+	if(batchSize <= 0) batchSize = DEFAULT_UNITY_BATCH_SIZE;
+	
+	QList<QStringList> batches;
+	QStringList sources;
+	QStringList objects;
+	for(int i = 0; i < files.size(); i += batchSize) {
+		QStringList batch;
+		foreach(const QString& file, files.mid(i, batchSize)) batch << QFileInfo(file).absoluteFilePath();
+		const QString source = writeUnitySource(batch);
+		if(source.isEmpty()) return compileUnits(compilation, files, flags, json);
+		batches << batch;
+		sources << source;
+		objects << QFileInfo(source).completeBaseName() + ".o";
+	}
+	
+	CommandChain chain(concurrency());
+	compilation->setupChain(&chain);
+	for(int i = 0; i < sources.size(); ++i) {
+		// gcc doesn't write the object on failure, which is how failed batches are found below
+		QFile::remove(outputDirectory().filePath(objects[i]));
+		chain.add(createUnitSegment(compilation, QStringList(flags) << "-c" << sources[i] << "-o" << objects[i],
+			QStringList(batches[i]).replaceInStrings(QRegExp("^.*/"), "").join(" "), "compile", objects[i]));
+	}
+	const bool chainSuccess = chain.execute();
+	QIODevice* err = chain.chainSession()->err();
+	err->seek(0);
+	
+	if(chain.cancelled() || chain.timedOut()) {
+		CompileResult result(false);
+		result.setCancelled(true);
+		return result + processOutput(err, json);
+	}
+	
+	QStringList fallback;
+	QStringList failedFiles;
+	for(int i = 0; i < sources.size(); ++i) {
+		if(QFile::exists(outputDirectory().filePath(objects[i]))) {
+			compilation->addFile(outputDirectory().path() + "/" + objects[i]);
+			continue;
+		}
+		qWarning() << "Unity batch" << sources[i] << "failed. Compiling its files individually.";
+		fallback << batches[i];
+		failedFiles << batches[i] << sources[i];
+	}
+	
+	// A batch that failed is only made up for by compiling its files again below
+	CompileResult result(chainSuccess || !fallback.isEmpty());
+	
+	// Keep diagnostics from batches that compiled. One pointing into a generated
+	// source keeps its position there, the #include line of the file it names.
+	DiagnosticList diagnostics;
+	foreach(Diagnostic diag, processOutput(err, json).diagnostics()) {
+		const QString file = QFileInfo(diag.file).absoluteFilePath();
+		if(failedFiles.contains(file)) continue;
+		const int batch = sources.indexOf(file);
+		if(batch >= 0 && diag.line > 0 && diag.line <= batches[batch].size()) {
+			DiagnosticNote note;
+			note.file = batches[batch][diag.line - 1];
+			note.message = "included by the unity build on that line";
+			diag.notes.prepend(note);
+		}
+		diagnostics << diag;
+	}
+	
+	QStringList raw;
+	foreach(const Diagnostic& diag, diagnostics) raw << diag.toString();
+	result += GccOutput::compileResult(diagnostics, raw.join("\n"));
+	
+	if(!fallback.isEmpty()) result += compileUnits(compilation, fallback, flags, json);
+	return result;
+}
+
+QString TestCompilerC::writeUnitySource(const QStringList& files)
+{
+	QDir dir = outputDirectory();
+	dir.mkdir(UNITY_DIRECTORY);
+	dir.cd(UNITY_DIRECTORY);
+	
+	// One #include per line so that line N of the generated source is files[N - 1]
+	QString contents;
+	foreach(const QString& file, files) contents += "#include \"" + file + "\"\n";
+	
+	const QByteArray hash = QCryptographicHash::hash(contents.toUtf8(), QCryptographicHash::Md5).toHex();
+	const QString path = dir.absoluteFilePath("unity_" + hash + ".c");
+	if(QFile::exists(path)) return path;
+	
+	QFile f(path);
+	if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Unable to write unity source" << path;
+		return QString();
+	}
+	f.write(contents.toUtf8());
+	f.close();
+	return path;
+}
+
+CompileResult TestCompilerC::processOutput(QIODevice* err, bool json)
+{
+	return json ? GccOutput::processJsonCompilerOutput(err) : GccOutput::processCompilerOutput(err);
 }
 
-QProcessSegment* TestCompilerC::createGccSegment(const QStringList& args)
+ChainSegment* TestCompilerC::createGccSegment(Compilation* compilation, const QStringList& args)
 {
-	QProcessSegment* ret = new QProcessSegment(gccPath(), args);
+	const QString& path = compilation->toolchain().path;
+	QProcessSegment* ret = new QProcessSegment(path, args);
 	ret->process()->setWorkingDirectory(outputDirectory().path());
 #ifdef Q_OS_WIN32
 	QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-	env.insert("PATH", env.value("Path") + ";" + QDir::toNativeSeparators(QDir::currentPath() + "/targets/gcc/mingw/bin"));
+	env.insert("PATH", env.value("Path") + ";" + QDir::toNativeSeparators(QFileInfo(path).absolutePath()));
 	ret->process()->setProcessEnvironment(env);
 #endif
 	return ret;
 }
 
-QString TestCompilerC::gccPath()
+ChainSegment* TestCompilerC::createUnitSegment(Compilation* compilation, const QStringList& args, const QString& name,
+	const QString& category, const QString& object)
 {
-#ifdef Q_OS_WIN32
-	return QDir::currentPath() + "/targets/gcc/mingw/bin/gcc.exe";
-#else
-	return "/usr/bin/gcc";
-#endif
-}
\ No newline at end of file
+	ChainSegment* segment = createGccSegment(compilation, args);
+	BuildProfile* profile = compilation->profile();
+	if(!profile) return segment;
+	
+	// clang writes the trace next to the object, named after it
+	QString timeTrace;
+	if(compilation->toolchain().hasFeature(TOOLCHAIN_TIME_TRACE)) {
+		const QFileInfo fi(outputDirectory(), object);
+		timeTrace = fi.absolutePath() + "/" + fi.completeBaseName() + ".json";
+	}
+	return new ProfiledSegment(profile, segment, name, category, timeTrace);
+}
+
+quint16 TestCompilerC::concurrency()
+{
+	const int idealProcesses = QThread::idealThreadCount();
+	return idealProcesses > 0 ? idealProcesses : 1;
+}
+
+QString TestCompilerC::precompiledHeader(Compilation* compilation, const QStringList& files, const QStringList& flags)
+{
+	if(compilation->settings().value(PRECOMPILED_HEADERS_KEY) == "false") return QString();
+	if(!compilation->toolchain().hasFeature(TOOLCHAIN_PCH)) return QString();
+	if(files.isEmpty()) return QString();
+	
+	QStringList prefix = includePrefix(files[0]);
+	foreach(const QString& file, files.mid(1)) {
+		const QStringList other = includePrefix(file);
+		int common = 0;
+		while(common < prefix.size() && common < other.size() && prefix[common] == other[common]) ++common;
+		prefix = prefix.mid(0, common);
+		if(prefix.isEmpty()) return QString();
+	}
+	if(prefix.isEmpty()) return QString();
+	
+	// The same includes built with different flags or another gcc need their own PCH
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(prefix.join("\n").toUtf8());
+	hash.addData(flags.join(" ").toUtf8());
+	hash.addData(compilation->toolchain().path.toUtf8());
+	hash.addData(compilation->toolchain().version.toUtf8());
+	
+	QDir dir = outputDirectory();
+	dir.mkdir(PCH_DIRECTORY);
+	dir.cd(PCH_DIRECTORY);
+	const QString header = dir.absoluteFilePath("prefix_" + hash.result().toHex() + ".h");
+	
+	QMutexLocker locker(&precompiledHeaderMutex);
+	if(isPrecompiledHeaderCurrent(header)) {
+		qDebug() << "Reusing precompiled header" << header;
+		return header;
+	}
+	
+	QFile headerFile(header);
+	if(!headerFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Unable to write precompiled header source" << header;
+		return QString();
+	}
+	QTextStream stream(&headerFile);
+	stream << prefix.join("\n") << "\n";
+	headerFile.close();
+	
+	qDebug() << "Building precompiled header for" << prefix;
+	CommandChain chain(1);
+	compilation->setupChain(&chain);
+	chain.add(createUnitSegment(compilation, QStringList(flags) << "-x" << "c-header" << header
+		<< "-o" << header + ".gch" << "-MD" << "-MF" << header + ".d", "precompiled header", "pch", header + ".gch"));
+	if(!chain.execute()) {
+		// Not fatal, the units are simply compiled without it
+		qWarning() << "Failed to build precompiled header" << header;
+		QFile::remove(header + ".gch");
+		return QString();
+	}
+	return header;
+}
+
+QStringList TestCompilerC::includePrefix(const QString& file)
+{
+	QStringList ret;
+	QFile f(file);
+	if(!f.open(QIODevice::ReadOnly | QIODevice::Text)) return ret;
+	
+	// Only system style includes are considered since quoted ones resolve
+	// relative to the source file. Anything else ends the prefix.
+	QRegExp include("^#\\s*include\\s*<[^>]+>$");
+	QTextStream stream(&f);
+	bool inComment = false;
+	while(!stream.atEnd()) {
+		const QString line = stream.readLine().trimmed();
+		if(inComment) {
+			inComment = !line.contains("*/");
+			continue;
+		}
+		if(line.isEmpty() || line.startsWith("//")) continue;
+		if(line.startsWith("/*")) {
+			inComment = !line.contains("*/");
+			continue;
+		}
+		if(!include.exactMatch(line)) break;
+		ret << line;
+	}
+	return ret;
+}
+
+bool TestCompilerC::isPrecompiledHeaderCurrent(const QString& header)
+{
+	const QFileInfo gch(header + ".gch");
+	if(!gch.exists()) return false;
+	
+	QFile depFile(header + ".d");
+	if(!depFile.open(QIODevice::ReadOnly)) return false;
+	
+	// Make style dependency list written by -MD: "target: dep dep \<newline> dep"
+	QString deps = QString::fromLocal8Bit(depFile.readAll());
+	deps.replace("\\\n", " ");
+	deps.replace("\\ ", QString(QChar(0)));
+	const int targetEnd = deps.indexOf(": ");
+	if(targetEnd < 0) return false;
+	QStringList paths = deps.mid(targetEnd + 2).split(QRegExp("\\s+"), QString::SkipEmptyParts);
+	if(paths.isEmpty()) return false;
+	
+	const QDateTime built = gch.lastModified();
+	foreach(QString path, paths) {
+		path.replace(QChar(0), ' ');
+		const QFileInfo dep(path);
+		if(!dep.exists() || dep.lastModified() > built) return false;
+	}
+	return true;
+}
@@ -4,10 +4,19 @@
 #include "Compilation.h"
 #include "Temporary.h"
 #include "GccOutput.h"
+#include "Toolchain.h"
+#include "BuildProfile.h"
 
 #include <QFileInfo>
+#include <QFile>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
 #include <QDebug>
 
+#define LINK_STAMP_SUFFIX ".link"
+#define LINK_HASH_CHUNK_BYTES (64 * 1024)
+
 TestCompilerO::TestCompilerO()
 	: Compiler("ld", QStringList() << "o")
 {
@@ -16,47 +25,118 @@ TestCompilerO::TestCompilerO()
 
 CompileResult TestCompilerO::compile(Compilation* compilation, const QStringList& files)
 {
-	int idealProcesses = QThread::idealThreadCount();
-	CommandChain chain(idealProcesses > 0 ? idealProcesses : 1);
-	QStringList cFlags = compilation->settings()["LD_FLAGS"].split(" ");
+	QStringList ldFlags = compilation->settings()["LD_FLAGS"].split(" ", QString::SkipEmptyParts);
 	const QString& executable = compilation->name();
-	QStringList strippedFiles;
-	foreach(const QString& file, files) {
-		QFileInfo fi(file);
-		strippedFiles << fi.path() + "/" + fi.fileName();
+	
+	const QString linker = compilation->settings().value(LINKER_KEY);
+	QString linkerFlag;
+	if(!ldFlags.filter("-fuse-ld=").isEmpty() || linker == "bfd") linkerFlag = QString();
+	else if(!linker.isEmpty()) linkerFlag = "-fuse-ld=" + linker;
+	else linkerFlag = fastLinkerFlag(compilation);
+	
+	QStringList args;
+	if(!linkerFlag.isEmpty()) args << linkerFlag;
+	// Libraries in LD_FLAGS have to come after the objects that use them
+	args << "-o" << executable << files << ldFlags;
+	
+	const QByteArray signature = linkSignature(compilation, args, files);
+	if(isLinkCurrent(executable, signature)) {
+		qDebug() << "Inputs to" << executable << "are unchanged. Skipping link.";
+		compilation->addCompileResult(outputDirectory().path() + "/" + executable);
+		CompileResult result(true);
+		result.addTiming("link", 0);
+		return result;
 	}
 	
-	chain.add(createGccSegment(QStringList() << "-o" << executable << files));
+	int idealProcesses = QThread::idealThreadCount();
+	CommandChain chain(idealProcesses > 0 ? idealProcesses : 1);
+	compilation->setupChain(&chain);
+	ChainSegment* segment = createGccSegment(compilation, args);
+	if(compilation->profile()) segment = new ProfiledSegment(compilation->profile(), segment, executable, "link");
+	chain.add(segment);
 	qDebug() << "Creating executable" << executable;
+	QElapsedTimer timer;
+	timer.start();
 	bool success = chain.execute();
+	const qint64 elapsed = timer.elapsed();
 	QIODevice* out = chain.chainSession()->out();
 	QIODevice* err = chain.chainSession()->err();
 	out->seek(0);
 	err->seek(0);
 	if(!success) {
 		qWarning() << "Chain execution failed";
-	} else compilation->addCompileResult(outputDirectory().path() + "/" + executable);
+		QFile::remove(outputDirectory().filePath(executable + LINK_STAMP_SUFFIX));
+	} else {
+		compilation->addCompileResult(outputDirectory().path() + "/" + executable);
+		writeLinkStamp(executable, signature);
+	}
+	qDebug() << "Linked" << executable << "in" << elapsed << "ms" << (linkerFlag.isEmpty() ? "" : "with") << linkerFlag;
 	
-	return CompileResult(success) + GccOutput::processLinkerOutput(err);
+	CompileResult result(success);
+	result.setCancelled(chain.cancelled() || chain.timedOut());
+	result.addTiming("link", elapsed);
+	return result + GccOutput::processLinkerOutput(err);
 }
 
-QProcessSegment* TestCompilerO::createGccSegment(const QStringList& args)
+QProcessSegment* TestCompilerO::createGccSegment(Compilation* compilation, const QStringList& args)
 {
-	QProcessSegment* ret = new QProcessSegment(gccPath(), args);
+	const QString& path = compilation->toolchain().path;
+	QProcessSegment* ret = new QProcessSegment(path, args);
 	ret->process()->setWorkingDirectory(outputDirectory().path());
 #ifdef Q_OS_WIN32
 	QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-	env.insert("PATH", env.value("Path") + ";" + QDir::toNativeSeparators(QDir::currentPath() + "/targets/gcc/mingw/bin"));
+	env.insert("PATH", env.value("Path") + ";" + QDir::toNativeSeparators(QFileInfo(path).absolutePath()));
 	ret->process()->setProcessEnvironment(env);
 #endif
 	return ret;
 }
 
-QString TestCompilerO::gccPath()
+QByteArray TestCompilerO::linkSignature(Compilation* compilation, const QStringList& args, const QStringList& files)
 {
-#ifdef Q_OS_WIN32
-	return QDir::currentPath() + "/targets/gcc/mingw/bin/gcc.exe";
-#else
-	return "/usr/bin/gcc";
-#endif
-}
\ No newline at end of file
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(compilation->toolchain().path.toUtf8());
+	hash.addData(compilation->toolchain().version.toUtf8());
+	hash.addData(args.join("\n").toUtf8());
+	// Every build rewrites the objects, so only their contents tell whether they changed
+	foreach(const QString& file, files) {
+		QFile f(file);
+		if(!f.open(QIODevice::ReadOnly)) return QByteArray();
+		hash.addData("\n" + QFileInfo(file).absoluteFilePath().toUtf8() + "\n");
+		while(!f.atEnd()) hash.addData(f.read(LINK_HASH_CHUNK_BYTES));
+	}
+	return hash.result().toHex();
+}
+
+bool TestCompilerO::isLinkCurrent(const QString& executable, const QByteArray& signature)
+{
+	if(signature.isEmpty()) return false;
+	const QFileInfo output(outputDirectory().filePath(executable));
+	if(!output.exists()) return false;
+	
+	QFile stamp(output.filePath() + LINK_STAMP_SUFFIX);
+	if(!stamp.open(QIODevice::ReadOnly)) return false;
+	// The stamp also records the executable's mtime so that replacing it by hand forces a relink
+	const QList<QByteArray> lines = stamp.readAll().split('\n');
+	return lines.size() >= 2 && lines[0] == signature
+		&& lines[1].toLongLong() == output.lastModified().toMSecsSinceEpoch();
+}
+
+void TestCompilerO::writeLinkStamp(const QString& executable, const QByteArray& signature)
+{
+	const QFileInfo output(outputDirectory().filePath(executable));
+	QFile stamp(output.filePath() + LINK_STAMP_SUFFIX);
+	if(!stamp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Unable to write link stamp" << stamp.fileName();
+		return;
+	}
+	stamp.write(signature + "\n" + QByteArray::number(output.lastModified().toMSecsSinceEpoch()) + "\n");
+}
+
+QString TestCompilerO::fastLinkerFlag(Compilation* compilation)
+{
+	// lld is usually the fastest, gold is still well ahead of bfd
+	const Toolchain& toolchain = compilation->toolchain();
+	if(toolchain.hasFeature(TOOLCHAIN_LLD)) return "-fuse-ld=lld";
+	if(toolchain.hasFeature(TOOLCHAIN_GOLD)) return "-fuse-ld=gold";
+	return QString();
+}
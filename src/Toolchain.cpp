@@ -0,0 +1,250 @@
+#include "Toolchain.h"
+
+#include "Kiss.h"
+
+#include <QProcess>
+#include <QSettings>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QRegExp>
+#include <QDebug>
+
+#define PROBE_MSECS 10000
+#define CACHE_VERSION 2
+
+Toolchain::Toolchain()
+	: majorVersion(0) {}
+
+const bool Toolchain::hasFeature(const QString& feature) const
+{
+	return features.contains(feature);
+}
+
+const bool Toolchain::isUsable() const
+{
+	return !path.isEmpty() && !family.isEmpty() && !machine.isEmpty();
+}
+
+ToolchainRegistry::ToolchainRegistry()
+	: m_discovered(false)
+{
+}
+
+void ToolchainRegistry::discover()
+{
+	QMutexLocker lock(&m_mutex);
+	if(m_discovered) return;
+	m_discovered = true;
+	
+	QElapsedTimer timer;
+	timer.start();
+	QSettings cache(cachePath(), QSettings::IniFormat);
+	if(cache.value("version").toInt() != CACHE_VERSION) {
+		cache.clear();
+		cache.setValue("version", CACHE_VERSION);
+	}
+	
+	QStringList seen;
+	QList<QPair<QString, QString> > candidates;
+	foreach(const QString& path, hostCandidates()) candidates << qMakePair(path, QString());
+	candidates += targetCandidates();
+	
+	for(int i = 0; i < candidates.size(); ++i) {
+		// /usr/bin/gcc is usually a link to one of the versioned drivers
+		const QString canonical = QFileInfo(candidates[i].first).canonicalFilePath();
+		if(canonical.isEmpty() || seen.contains(canonical + candidates[i].second)) continue;
+		seen << canonical + candidates[i].second;
+		
+		const Toolchain toolchain = probe(candidates[i].first, candidates[i].second, &cache);
+		if(!toolchain.isUsable()) continue;
+		m_toolchains << toolchain;
+		qDebug() << "Found toolchain" << toolchain.path << toolchain.family << toolchain.version
+			<< toolchain.machine << toolchain.target << toolchain.features;
+	}
+	cache.sync();
+	qDebug() << "Toolchain discovery took" << timer.elapsed() << "ms";
+}
+
+QList<Toolchain> ToolchainRegistry::toolchains()
+{
+	discover();
+	QMutexLocker lock(&m_mutex);
+	return m_toolchains;
+}
+
+Toolchain ToolchainRegistry::toolchain(const QString& target, const QString& preferred)
+{
+	const QList<Toolchain> all = toolchains();
+	
+	if(!preferred.isEmpty()) {
+		foreach(const Toolchain& toolchain, all) {
+			if(toolchain.name == preferred || toolchain.path == preferred) return toolchain;
+		}
+		qWarning() << "Toolchain" << preferred << "was not found. Picking one instead.";
+	}
+	
+	QList<Toolchain> candidates;
+	foreach(const Toolchain& toolchain, all) {
+		if(!target.isEmpty() && toolchain.target == target) candidates << toolchain;
+	}
+	if(candidates.isEmpty()) {
+		foreach(const Toolchain& toolchain, all) {
+			if(toolchain.target.isEmpty()) candidates << toolchain;
+		}
+	}
+	if(candidates.isEmpty()) return fallback();
+	
+	// Always the same compiler, rather than whichever timed fastest. gcc is
+	// what the diagnostics parsing and precompiled headers were written for.
+	foreach(const Toolchain& toolchain, candidates) {
+		if(toolchain.name == "gcc" || toolchain.name == "gcc.exe") return toolchain;
+	}
+	foreach(const Toolchain& toolchain, candidates) {
+		if(toolchain.family == "gcc") return toolchain;
+	}
+	return candidates[0];
+}
+
+Toolchain ToolchainRegistry::identify(const QString& path)
+{
+	Toolchain ret;
+	ret.path = path;
+	ret.name = QFileInfo(path).fileName();
+	
+	bool ok = false;
+	const QString versionText = run(path, QStringList() << "--version", &ok);
+	if(!ok) return ret;
+	ret.family = versionText.contains("clang") ? "clang" : "gcc";
+	if(ret.family == "gcc") ret.version = run(path, QStringList() << "-dumpfullversion", &ok).trimmed();
+	if(ret.version.isEmpty() || !ok) {
+		// clang's -dumpversion claims to be an old gcc, so read --version instead
+		QRegExp version("version ([0-9]+(\\.[0-9]+)*)");
+		if(version.indexIn(versionText) >= 0) ret.version = version.cap(1);
+	}
+	ret.majorVersion = ret.version.section('.', 0, 0).toInt();
+	ret.machine = run(path, QStringList() << "-dumpmachine").trimmed();
+	return ret;
+}
+
+Toolchain ToolchainRegistry::fallback()
+{
+	Toolchain ret;
+	ret.family = "gcc";
+#ifdef Q_OS_WIN32
+	ret.path = QDir::currentPath() + "/" TARGET_FOLDER "/gcc/mingw/bin/gcc.exe";
+#else
+	ret.path = "/usr/bin/gcc";
+#endif
+	ret.name = QFileInfo(ret.path).fileName();
+	return ret;
+}
+
+QString ToolchainRegistry::cachePath()
+{
+	// Next to the regular settings file, but separate since it's only a cache
+	const QSettings settings(QSettings::IniFormat, QSettings::UserScope, "KIPR", "KISS");
+	return QFileInfo(settings.fileName()).absolutePath() + "/toolchains.ini";
+}
+
+QStringList ToolchainRegistry::hostCandidates() const
+{
+	QStringList ret;
+#ifdef Q_OS_WIN32
+	ret << fallback().path;
+#else
+	QStringList dirs;
+	dirs << "/usr/bin" << "/usr/local/bin";
+	foreach(const QString& path, QString::fromLocal8Bit(qgetenv("PATH")).split(':', QString::SkipEmptyParts)) {
+		if(!dirs.contains(path)) dirs << path;
+	}
+	QRegExp driver("(gcc|clang)(-[0-9.]+)?");
+	foreach(const QString& dir, dirs) {
+		foreach(const QString& name, QDir(dir).entryList(QStringList() << "gcc*" << "clang*", QDir::Files | QDir::Executable)) {
+			if(driver.exactMatch(name)) ret << QDir(dir).absoluteFilePath(name);
+		}
+	}
+#endif
+	return ret;
+}
+
+QList<QPair<QString, QString> > ToolchainRegistry::targetCandidates() const
+{
+	QList<QPair<QString, QString> > ret;
+	QDir targets(QDir::currentPath() + "/" TARGET_FOLDER);
+	// Cross drivers are named after the machine they build for: arm-linux-gnueabi-gcc
+	QRegExp driver("([A-Za-z0-9_.]+-)*(gcc|clang)(-[0-9.]+)?(\\.exe)?");
+	foreach(const QString& target, targets.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+		QDirIterator it(targets.absoluteFilePath(target), QDir::Files | QDir::Executable, QDirIterator::Subdirectories);
+		while(it.hasNext()) {
+			const QFileInfo fi(it.next());
+			if(fi.dir().dirName() != "bin" || !driver.exactMatch(fi.fileName())) continue;
+			ret << qMakePair(fi.absoluteFilePath(), target);
+		}
+	}
+	return ret;
+}
+
+Toolchain ToolchainRegistry::probe(const QString& path, const QString& target, QSettings* cache)
+{
+	const QFileInfo binary(QFileInfo(path).canonicalFilePath());
+	const QString group = QCryptographicHash::hash((path + "\n" + target).toUtf8(), QCryptographicHash::Md5).toHex();
+	const QString stamp = QString("%1 %2").arg(binary.size()).arg(binary.lastModified().toMSecsSinceEpoch());
+	
+	Toolchain ret;
+	ret.path = path;
+	ret.name = QFileInfo(path).fileName();
+	ret.target = target;
+	
+	cache->beginGroup(group);
+	if(cache->value("stamp").toString() == stamp) {
+		ret.family = cache->value("family").toString();
+		ret.version = cache->value("version").toString();
+		ret.majorVersion = cache->value("majorVersion").toInt();
+		ret.machine = cache->value("machine").toString();
+		ret.features = cache->value("features").toStringList();
+		cache->endGroup();
+		return ret;
+	}
+	cache->endGroup();
+	
+	qDebug() << "Probing toolchain" << path;
+	ret = identify(path);
+	ret.target = target;
+	bool ok = false;
+	if(!ret.family.isEmpty()) {
+		const bool gcc = ret.family == "gcc";
+		if(gcc && ret.majorVersion >= 9) ret.features << TOOLCHAIN_JSON_DIAGNOSTICS;
+		if(gcc) ret.features << TOOLCHAIN_PCH;
+		ret.features << TOOLCHAIN_TIME_REPORT;
+		if(!gcc && ret.majorVersion >= 9) ret.features << TOOLCHAIN_TIME_TRACE;
+		run(path, QStringList() << "-fuse-ld=lld" << "-Wl,--version", &ok);
+		if(ok) ret.features << TOOLCHAIN_LLD;
+		run(path, QStringList() << "-fuse-ld=gold" << "-Wl,--version", &ok);
+		if(ok) ret.features << TOOLCHAIN_GOLD;
+	}
+	
+	cache->beginGroup(group);
+	cache->setValue("stamp", stamp);
+	cache->setValue("path", path);
+	cache->setValue("family", ret.family);
+	cache->setValue("version", ret.version);
+	cache->setValue("majorVersion", ret.majorVersion);
+	cache->setValue("machine", ret.machine);
+	cache->setValue("features", ret.features);
+	cache->endGroup();
+	return ret;
+}
+
+QString ToolchainRegistry::run(const QString& path, const QStringList& args, bool* ok)
+{
+	QProcess process;
+	process.start(path, args);
+	const bool finished = process.waitForFinished(PROBE_MSECS);
+	if(!finished) process.kill();
+	if(ok) *ok = finished && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+	return QString::fromLocal8Bit(process.readAllStandardOutput());
+}
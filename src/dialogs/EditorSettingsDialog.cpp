@@ -20,7 +20,6 @@
 
 #include "EditorSettingsDialog.h"
 
-#include <QSettings>
 #include <QDebug>
 
 EditorSettingsDialog::EditorSettingsDialog(QWidget *parent) : QDialog(parent)
@@ -53,84 +52,49 @@ int EditorSettingsDialog::exec()
 	return QDialog::Accepted;
 }
 
-// Save the settings from the dialog
+// Publish the settings from the dialog to every editor
 void EditorSettingsDialog::saveSettings()
 {
-	qWarning() << "Font" << ui_fontBox->currentFont().family();
-	QSettings settings;
-	settings.beginGroup(EDITOR);
-	settings.setValue(FONT, ui_fontBox->currentFont().family());
-	settings.setValue(FONT_SIZE, ui_fontSizeSpinBox->value());
+	EditorSettings settings;
+	settings.font = QFont(ui_fontBox->currentFont().family(), ui_fontSizeSpinBox->value());
 	
-	settings.beginGroup(AUTO_COMPLETION);
-	settings.setValue(ENABLED, ui_autoCompletionEnabledCheckBox->isChecked());
-	settings.setValue(API_SOURCE, ui_autoCompletionAPISourceCheckBox->isChecked());
-	settings.setValue(DOC_SOURCE, ui_autoCompletionDocumentSourceCheckBox->isChecked());
-	settings.setValue(THRESHOLD, ui_autoCompletionThresholdSpinBox->value());
-	settings.endGroup();
-
-	settings.beginGroup(AUTO_INDENT);
-	settings.setValue(ENABLED, ui_autoIndentEnabledCheckBox->isChecked());
-	if(ui_autoIndentMaintainStyleRadioButton->isChecked()) settings.setValue(STYLE, MAINTAIN);
-	else if (ui_autoIndentIntelligentStyleRadioButton->isChecked()) settings.setValue(STYLE, INTELLIGENT);
-	settings.setValue(WIDTH, ui_autoIndentWidthSpinBox->value());
-	settings.endGroup();
-
-	settings.setValue(CALL_TIPS, ui_callTipsCheckBox->isChecked());
-	settings.setValue(BRACE_MATCHING, ui_braceMatchingCheckBox->isChecked());
-	settings.setValue(LINE_NUMBERS, ui_marginLineNumbersCheckBox->isChecked());
-	settings.setValue(DEBUGGER_ENABLED, ui_debugger->isChecked());
-	settings.endGroup();
-	settings.sync();
+	settings.autoCompletion = ui_autoCompletionEnabledCheckBox->isChecked();
+	settings.apiSource = ui_autoCompletionAPISourceCheckBox->isChecked();
+	settings.documentSource = ui_autoCompletionDocumentSourceCheckBox->isChecked();
+	settings.autoCompletionThreshold = ui_autoCompletionThresholdSpinBox->value();
+	
+	settings.autoIndent = ui_autoIndentEnabledCheckBox->isChecked();
+	settings.maintainIndent = ui_autoIndentMaintainStyleRadioButton->isChecked();
+	settings.indentWidth = ui_autoIndentWidthSpinBox->value();
+	
+	settings.callTips = ui_callTipsCheckBox->isChecked();
+	settings.braceMatching = ui_braceMatchingCheckBox->isChecked();
+	settings.lineNumbers = ui_marginLineNumbersCheckBox->isChecked();
+	settings.debuggerEnabled = ui_debugger->isChecked();
+	
+	EditorSettings::publish(settings);
 }
 
-// Read settings from the app config, setting defaults if necessary
+// Show the current settings, which have defaults for anything never saved
 void EditorSettingsDialog::readSettings()
 {
-	// Open up the applications settings and look in the editor group
-	QSettings settings;
-	settings.beginGroup(EDITOR);
-
-	// Figure out the font and set it
-	#ifdef Q_OS_WIN32
-	QString fontString = settings.value(FONT, "Courier New").toString();
-	#elif defined(Q_OS_MAC)
-	QString fontString = settings.value(FONT, "Monaco").toString();
-	#else
-	QString fontString = settings.value(FONT, "Monospace").toString();
-	#endif
+	const EditorSettings& settings = EditorSettings::current();
 	
-	ui_fontBox->setCurrentFont(QFont(fontString));
+	ui_fontBox->setCurrentFont(QFont(settings.font.family()));
+	ui_fontSizeSpinBox->setValue(settings.font.pointSize());
 	
-	// Figure out the font size and set the widget
-	#ifdef Q_OS_MAC
-	ui_fontSizeSpinBox->setValue(settings.value(FONT_SIZE, 12).toInt());
-	#else
-	ui_fontSizeSpinBox->setValue(settings.value(FONT_SIZE, 10).toInt());
-	#endif
-
-	// Set the auto completion settings from the application config
-	settings.beginGroup(AUTO_COMPLETION);
-	ui_autoCompletionEnabledCheckBox->setChecked(settings.value(ENABLED, false).toBool());
-	ui_autoCompletionAPISourceCheckBox->setChecked(settings.value(API_SOURCE, false).toBool());
-	ui_autoCompletionDocumentSourceCheckBox->setChecked(settings.value(DOC_SOURCE, false).toBool());
-	ui_autoCompletionThresholdSpinBox->setValue(settings.value(THRESHOLD, 4).toInt());
-	settings.endGroup();
-
-	// Set the auto indent settings from the application config
-	settings.beginGroup(AUTO_INDENT);
-	ui_autoIndentEnabledCheckBox->setChecked(settings.value(ENABLED, true).toBool());
-	if(settings.value(STYLE).toString() == MAINTAIN) ui_autoIndentMaintainStyleRadioButton->setChecked(true);
-	else if(settings.value(STYLE).toString() == INTELLIGENT) ui_autoIndentIntelligentStyleRadioButton->setChecked(true);
-	ui_autoIndentWidthSpinBox->setValue(settings.value(WIDTH, 4).toInt());
-	settings.endGroup();
-
-	// Set the misc options from the application config
-	ui_callTipsCheckBox->setChecked(settings.value(CALL_TIPS, true).toBool());
-	ui_braceMatchingCheckBox->setChecked(settings.value(BRACE_MATCHING, true).toBool());
-	ui_marginLineNumbersCheckBox->setChecked(settings.value(LINE_NUMBERS, true).toBool());
-	ui_debugger->setChecked(settings.value(DEBUGGER_ENABLED, false).toBool());
-
-	settings.endGroup();
+	ui_autoCompletionEnabledCheckBox->setChecked(settings.autoCompletion);
+	ui_autoCompletionAPISourceCheckBox->setChecked(settings.apiSource);
+	ui_autoCompletionDocumentSourceCheckBox->setChecked(settings.documentSource);
+	ui_autoCompletionThresholdSpinBox->setValue(settings.autoCompletionThreshold);
+	
+	ui_autoIndentEnabledCheckBox->setChecked(settings.autoIndent);
+	if(settings.maintainIndent) ui_autoIndentMaintainStyleRadioButton->setChecked(true);
+	else ui_autoIndentIntelligentStyleRadioButton->setChecked(true);
+	ui_autoIndentWidthSpinBox->setValue(settings.indentWidth);
+	
+	ui_callTipsCheckBox->setChecked(settings.callTips);
+	ui_braceMatchingCheckBox->setChecked(settings.braceMatching);
+	ui_marginLineNumbersCheckBox->setChecked(settings.lineNumbers);
+	ui_debugger->setChecked(settings.debuggerEnabled);
 }
-
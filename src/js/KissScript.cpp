@@ -56,7 +56,10 @@ QString KissScript::cwd() const
 QScriptValue KissScript::plugin(const QString& type, const QScriptValue& obj)
 {
 	if(type == "compiler") {
-		Compilers::ref().addCompiler(new CompilerPlugin(obj));
+		CompilerPlugin* compiler = new CompilerPlugin(obj);
+		Compilers::ref().addCompiler(compiler);
+		// Compilations only look at CompilerManager
+		CompilerManager::ref().addCompiler(compiler);
 		return true;
 	}
 	if(type == "lexer") {
@@ -0,0 +1,91 @@
+#include "LexerAPIs.h"
+
+#include "LexerFactory.h"
+
+#include <Qsci/qsciapis.h>
+#include <Qsci/qscilexer.h>
+#include <Qsci/qsciglobal.h>
+
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QStringList>
+#include <QCryptographicHash>
+#include <QDebug>
+
+using namespace Lexer;
+
+APIs::APIs()
+{
+	
+}
+
+APIs::~APIs()
+{
+	foreach(const Entry& entry, m_entries) delete entry.owner->lexer();
+}
+
+void APIs::attach(LexerBase* lexer, const QString& file)
+{
+	if(!lexer) return;
+	const QFileInfo info(file);
+	if(!info.isFile()) return;
+	
+	// Lexers of different languages split words differently, so each prepares its own
+	const QString key = lexer->lexer()->language() + QString(":") + info.absoluteFilePath();
+	QMap<QString, Entry>::iterator it = m_entries.find(key);
+	if(it == m_entries.end()) it = m_entries.insert(key, load(lexer, info.absoluteFilePath()));
+	if(it.value().apis) lexer->lexer()->setAPIs(it.value().apis);
+}
+
+QString APIs::cacheDirectory()
+{
+	const QSettings settings(QSettings::IniFormat, QSettings::UserScope, "KIPR", "KISS");
+	return QFileInfo(settings.fileName()).absolutePath() + "/apis";
+}
+
+void APIs::preparationFinished()
+{
+	QsciAPIs* apis = qobject_cast<QsciAPIs*>(sender());
+	foreach(const Entry& entry, m_entries) {
+		if(entry.apis != apis) continue;
+		QDir().mkpath(cacheDirectory());
+		if(!apis->savePrepared(entry.cachePath)) qWarning() << "Unable to cache prepared APIs to" << entry.cachePath;
+		return;
+	}
+}
+
+APIs::Entry APIs::load(LexerBase* lexer, const QString& file)
+{
+	Entry ret;
+	ret.owner = 0;
+	ret.apis = 0;
+	
+	QFile f(file);
+	if(!f.open(QIODevice::ReadOnly)) {
+		qWarning() << "Unable to read APIs from" << file;
+		return ret;
+	}
+	const QByteArray contents = f.readAll();
+	
+	// What is prepared depends on the file, the language and QScintilla's format
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(contents);
+	hash.addData(lexer->lexer()->language());
+	hash.addData(QSCINTILLA_VERSION_STR);
+	ret.cachePath = cacheDirectory() + "/" + hash.result().toHex() + ".prepared";
+	
+	ret.owner = lexer->constructor()->_new();
+	ret.apis = new QsciAPIs(ret.owner->lexer());
+	if(QFile::exists(ret.cachePath) && ret.apis->loadPrepared(ret.cachePath)) return ret;
+	
+	// Same as QsciAPIs::load(), without reading the file again
+	foreach(const QString& line, QString::fromUtf8(contents).split('\n')) {
+		const QString api = line.trimmed();
+		if(!api.isEmpty()) ret.apis->add(api);
+	}
+	connect(ret.apis, SIGNAL(apiPreparationFinished()), SLOT(preparationFinished()));
+	ret.apis->prepare();
+	return ret;
+}
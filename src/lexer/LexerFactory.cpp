@@ -24,11 +24,17 @@
 #include "LexerCPP.h"
 #include "LexerJava.h"
 #include "LexerJavaScript.h"
+#include "LexerAPIs.h"
 
 #include <QDebug>
 
 using namespace Lexer;
 
+void LexerBase::setAPIFile(const QString& apis)
+{
+	APIs::ref().attach(this, apis);
+}
+
 Factory::Factory()
 {
 	registerLexerConstructor(new ConstructorJava(), QStringList() << "java");
@@ -74,6 +80,42 @@ void Factory::registerLexerConstructor(Constructor* c, const QStringList& exts)
 	foreach(const QString& ext, exts) m_constructors[ext] = c;
 }
 
+LexerBase* Factory::acquire(const Constructor* constructor, const QString& apis, int autoIndentStyle)
+{
+	if(!constructor) return 0;
+	// The indent style lives in the lexer, so editors using different ones can't share it
+	const QString key = QString::number((qulonglong)(quintptr)constructor) + ":" + QString::number(autoIndentStyle)
+		+ ":" + apis;
+	LexerBase* ret = m_shared.value(key);
+	if(ret) {
+		++m_acquired[ret].refs;
+		return ret;
+	}
+	
+	ret = newLexerFromConstructor(constructor);
+	ret->lexer()->setAutoIndentStyle(autoIndentStyle);
+	setAPIsForLexer(ret, apis);
+	Acquired acquired;
+	acquired.key = key;
+	acquired.apis = apis;
+	acquired.refs = 1;
+	m_shared[key] = ret;
+	m_acquired[ret] = acquired;
+	return ret;
+}
+
+void Factory::release(LexerBase* lexer)
+{
+	if(!lexer) return;
+	QMap<LexerBase*, Acquired>::iterator it = m_acquired.find(lexer);
+	if(it != m_acquired.end()) {
+		if(--it.value().refs > 0) return;
+		m_shared.remove(it.value().key);
+		m_acquired.erase(it);
+	}
+	delete lexer->lexer();
+}
+
 void Factory::setAPIsForLexer(LexerBase* lexer, const QString& apis)
 {
 	if(!lexer) return;
@@ -88,7 +130,10 @@ bool Factory::isLexerFromConstructor(LexerBase* lexer, Constructor* constructor)
 
 void Factory::setFont(const QFont& font)
 {
+	// Every tab applies the settings, but restyling once is enough
+	if(font == m_font) return;
 	m_font = font;
+	foreach(LexerBase* lexer, m_acquired.keys()) lexer->lexer()->setFont(m_font, -1);
 }
 
 QFont Factory::font() const
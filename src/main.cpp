@@ -33,10 +33,15 @@
 
 #include "Compiler.h"
 #include "TestCompilerC.h"
+#include "DistributedCompilerC.h"
 #include "TestCompilerO.h"
+#include "Toolchain.h"
+#include "BatchBuild.h"
 
 #include <QTimer>
+#include <QtConcurrentRun>
 #include <QDebug>
+#include <cstdio>
 #include <BackendCapabilities>
 
 using namespace std;
@@ -119,9 +124,45 @@ void debugLogHandler(QtMsgType type, const char *msg)
 	}
 }
 
+void setupApplication()
+{
+	#ifdef Q_OS_MAC
+		QDir::setCurrent(QApplication::applicationDirPath() + "/../");
+	#else
+		QDir::setCurrent(QApplication::applicationDirPath());
+	#endif
+
+	QApplication::setOrganizationName("KIPR");
+	QApplication::setOrganizationDomain("kipr.org");
+	QApplication::setApplicationName("KISS");
+	
+	// Compile daemons are opt-in until they are shown to be faster
+#ifdef Q_OS_UNIX
+	if(qgetenv(COMPILE_BACKEND_ENV) == "distributed") CompilerManager::ref().addCompiler(new DistributedCompilerC());
+	else
+#endif
+	CompilerManager::ref().addCompiler(new TestCompilerC());
+	CompilerManager::ref().addCompiler(new TestCompilerO());
+}
+
+int batchBuild()
+{
+	BatchBuild build;
+	// Before setupApplication() changes directory, so relative project paths still resolve
+	if(!build.parseArguments(QApplication::arguments().mid(2))) {
+		fprintf(stderr, "%s", qPrintable(BatchBuild::usage()));
+		return BATCH_BUILD_USAGE;
+	}
+	setupApplication();
+	return build.exec();
+}
+
 int main(int argc, char **argv)
 {
-	QApplication application(argc, argv);
+	// Batch builds run on servers without a display
+	const bool batch = argc > 1 && QString(argv[1]) == "--build";
+	QApplication application(argc, argv, !batch);
+	if(batch) return batchBuild();
 	
 #ifdef ENABLE_LOG_WINDOW
 	streambuf* restore = cout.rdbuf();
@@ -139,19 +180,11 @@ int main(int argc, char **argv)
 		return 0;
 	}
 	
-	#ifdef Q_OS_MAC
-		QDir::setCurrent(QApplication::applicationDirPath() + "/../");
-	#else
-		QDir::setCurrent(QApplication::applicationDirPath());
-	#endif
-
-	QApplication::setOrganizationName("KIPR");
-	QApplication::setOrganizationDomain("kipr.org");
-	QApplication::setApplicationName("KISS");
+	setupApplication();
 	QApplication::setWindowIcon(QIcon(":/icon.png"));
 	
-	CompilerManager::ref().addCompiler(new TestCompilerC());
-	CompilerManager::ref().addCompiler(new TestCompilerO());
+	// Cached on disk, but probing new compilers takes a moment so keep it off the GUI thread
+	QtConcurrent::run(&ToolchainRegistry::ref(), &ToolchainRegistry::discover);
 	
 	QPixmap splashPixmap(":/splash_screen.png");
 	QSplashScreen splash(splashPixmap);
@@ -1,9 +1,14 @@
 #include "ErrorWidget.h"
 
 #include <QListWidget>
+#include <QSet>
 #include <QDebug>
 
-ErrorWidget::ErrorWidget(QWidget* parent) : QWidget(parent), m_unit(0)
+#define FILE_ROLE (Qt::UserRole)
+#define LINE_ROLE (Qt::UserRole + 1)
+#define COLUMN_ROLE (Qt::UserRole + 2)
+
+ErrorWidget::ErrorWidget(QWidget* parent) : QWidget(parent), m_current(0), m_unit(0)
 {
 	setupUi(this);
 	setCategorized();
@@ -20,15 +25,45 @@ void ErrorWidget::setCompileResult(const WorkingUnit* unit, const CompileResult&
 		delete widget;
 	}
 	
-	const QMap<QString, QStringList>& categories = results.categorizedOutput();
+	// Errors and warnings come from the structured diagnostics when we have them.
+	// Lines that only exist as text, such as linker errors, are kept after them.
+	QMap<QString, QStringList> categories = results.categorizedOutput();
+	const DiagnosticList& diagnostics = results.diagnostics();
+	QStringList textErrors;
+	QStringList textWarnings;
+	if(!diagnostics.isEmpty()) {
+		QSet<QString> covered;
+		foreach(const Diagnostic& diag, diagnostics) {
+			covered << diag.toString();
+			foreach(const DiagnosticNote& note, diag.notes) covered << note.toString();
+		}
+		foreach(const QString& line, categories.take(DEFAULT_ERROR_KEY)) if(!covered.contains(line)) textErrors << line;
+		foreach(const QString& line, categories.take(DEFAULT_WARNING_KEY)) if(!covered.contains(line)) textWarnings << line;
+	}
+	
+	QMap<QString, QListWidget*> lists;
+	foreach(const QString& key, categories.keys()) {
+		QListWidget* listWidget = createList();
+		foreach(const QString& line, categories.value(key)) listWidget->addItem(line);
+		lists[key] = listWidget;
+	}
+	if(!diagnostics.isEmpty()) {
+		QListWidget* errors = createDiagnosticList(diagnostics, Diagnostic::Error);
+		QListWidget* warnings = createDiagnosticList(diagnostics, Diagnostic::Warning);
+		errors->addItems(textErrors);
+		warnings->addItems(textWarnings);
+		if(errors->count()) lists[DEFAULT_ERROR_KEY] = errors;
+		else delete errors;
+		if(warnings->count()) lists[DEFAULT_WARNING_KEY] = warnings;
+		else delete warnings;
+	}
+	
 	int largest = -1;
 	int largestSize = 0;
-	foreach(const QString& key, categories.keys()) {
-		QListWidget* listWidget = new QListWidget(this);
-		const QStringList& items = categories.value(key);
-		foreach(const QString& line, items) listWidget->addItem(line);
+	foreach(const QString& key, lists.keys()) {
+		QListWidget* listWidget = lists.value(key);
 		const int i = ui_tabs->addTab(listWidget, key);
-		if(items.size() > largestSize && largestSize >= 0) largest = i;
+		if(listWidget->count() > largestSize && largestSize >= 0) largest = i;
 		if(key == DEFAULT_ERROR_KEY) {
 			largest = i;
 			largestSize = -1;
@@ -57,6 +92,47 @@ void ErrorWidget::on_ui_viewMode_currentIndexChanged(int index)
 	}
 }
 
+void ErrorWidget::itemActivated(QListWidgetItem* item)
+{
+	const int line = item->data(LINE_ROLE).toInt();
+	if(line <= 0) return;
+	emit diagnosticActivated(item->data(FILE_ROLE).toString(), line, item->data(COLUMN_ROLE).toInt());
+}
+
+QListWidget* ErrorWidget::createList()
+{
+	QListWidget* ret = new QListWidget(this);
+	connect(ret, SIGNAL(itemActivated(QListWidgetItem*)), SLOT(itemActivated(QListWidgetItem*)));
+	return ret;
+}
+
+QListWidget* ErrorWidget::createDiagnosticList(const DiagnosticList& diagnostics, Diagnostic::Severity severity)
+{
+	QListWidget* ret = createList();
+	foreach(const Diagnostic& diag, diagnostics) {
+		if(diag.severity != severity) continue;
+		
+		QStringList toolTip = diag.context;
+		foreach(const DiagnosticFixit& fixit, diag.fixits) {
+			toolTip << tr("Suggested fix at line %1, column %2: \"%3\"").arg(fixit.line).arg(fixit.column).arg(fixit.replacement);
+		}
+		
+		QListWidgetItem* item = new QListWidgetItem(diag.toString(), ret);
+		item->setData(FILE_ROLE, diag.file);
+		item->setData(LINE_ROLE, diag.line);
+		item->setData(COLUMN_ROLE, diag.column);
+		if(!toolTip.isEmpty()) item->setToolTip(toolTip.join("\n"));
+		
+		foreach(const DiagnosticNote& note, diag.notes) {
+			QListWidgetItem* noteItem = new QListWidgetItem("    " + note.toString(), ret);
+			noteItem->setData(FILE_ROLE, note.file);
+			noteItem->setData(LINE_ROLE, note.line);
+			noteItem->setData(COLUMN_ROLE, note.column);
+		}
+	}
+	return ret;
+}
+
 void ErrorWidget::setCategorized()
 {
 	ui_raw->hide();
@@ -67,4 +143,4 @@ void ErrorWidget::setRaw()
 {
 	ui_raw->show();
 	ui_tabs->hide();
-}
\ No newline at end of file
+}
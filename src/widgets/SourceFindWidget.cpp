@@ -21,8 +21,9 @@
 #include "SourceFindWidget.h"
 
 #include "SourceFile.h"
+#include "FindIndex.h"
 
-SourceFindWidget::SourceFindWidget(QWidget* parent) : QWidget(parent), m_sourceFile(0)
+SourceFindWidget::SourceFindWidget(QWidget* parent) : QWidget(parent), m_sourceFile(0), m_index(0), m_findModified(false)
 {
 	setupUi(this);
 }
@@ -30,6 +31,8 @@ SourceFindWidget::SourceFindWidget(QWidget* parent) : QWidget(parent), m_sourceF
 void SourceFindWidget::setSourceFile(SourceFile* sourceFile)
 {
 	m_sourceFile = sourceFile;
+	delete m_index;
+	m_index = new FindIndex(m_sourceFile->editor(), this);
 }
 
 void SourceFindWidget::setModified(bool m)
@@ -49,29 +52,54 @@ void SourceFindWidget::show()
 	QWidget::show();
 }
 
+void SourceFindWidget::hideEvent(QHideEvent* event)
+{
+	// Highlights are only wanted while searching. Switching tabs hides us too,
+	// but then the query is still there when the tab comes back.
+	if(m_index && isHidden()) m_index->clear();
+	QWidget::hideEvent(event);
+}
+
 void SourceFindWidget::on_ui_next_clicked()
 {
-	if(m_findModified) m_sourceFile->editor()->findFirst(ui_find->text(), false, ui_matchCase->isChecked(), false, true);
-	else m_sourceFile->editor()->findNext();
+	if(!m_index) return;
 	m_findModified = false;
+	
+	// Starting after the selection skips the match that was found last
+	QsciScintilla* editor = m_sourceFile->editor();
+	const int match = m_index->matchAfter(editor->SendScintilla(QsciScintilla::SCI_GETSELECTIONEND));
+	if(match < 0) return;
+	
+	const int start = m_index->matchStart(match);
+	editor->ensureLineVisible(editor->SendScintilla(QsciScintilla::SCI_LINEFROMPOSITION, start));
+	editor->SendScintilla(QsciScintilla::SCI_SETSEL, start, start + m_index->matchLength());
 }
 
 void SourceFindWidget::on_ui_find_textChanged(const QString&)
 {
 	m_findModified = true;
+	updateQuery();
 }
 
 void SourceFindWidget::on_ui_matchCase_stateChanged(int)
 {
 	m_findModified = true;
+	updateQuery();
 }
 
 void SourceFindWidget::on_ui_replaceNext_clicked()
 {
-	m_sourceFile->editor()->replace(ui_replace->text()); on_ui_next_clicked();
+	if(!m_index) return;
+	m_index->replaceSelection(ui_replace->text());
+	on_ui_next_clicked();
 }
 
 void SourceFindWidget::on_ui_replaceAll_clicked()
 {
-	m_sourceFile->editor()->setText(m_sourceFile->editor()->text().replace(ui_find->text(), ui_replace->text()));
-}
\ No newline at end of file
+	if(m_index) m_index->replaceAll(ui_replace->text());
+}
+
+void SourceFindWidget::updateQuery()
+{
+	if(m_index) m_index->setQuery(ui_find->text(), ui_matchCase->isChecked());
+}
@@ -0,0 +1,200 @@
+#include "CommandChain.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include <ctime>
+
+#define TRUE_EXECUTABLE "/bin/true"
+
+#define DEFAULT_SEGMENTS 2000
+#define DEFAULT_REPEATS 3
+
+struct BenchmarkResult
+{
+	QString name;
+	quint16 concurrency;
+	int segments;
+	qint64 wallMs;
+	double cpuMs;
+	double firstStartMs;
+	bool success;
+};
+
+// Records when run() is first called so we can measure the delay between
+// CommandChain::execute() and the first segment actually starting.
+class StampedTimeSegment : public TimeSegment
+{
+public:
+	StampedTimeSegment(long time, QElapsedTimer* clock, qint64* firstStart)
+		: TimeSegment(time), m_clock(clock), m_firstStart(firstStart) {}
+
+	virtual const bool run()
+	{
+		if(*m_firstStart < 0) *m_firstStart = m_clock->nsecsElapsed();
+		return TimeSegment::run();
+	}
+private:
+	QElapsedTimer* m_clock;
+	qint64* m_firstStart;
+};
+
+static double cpuMilliseconds()
+{
+	return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+static BenchmarkResult runProcessChain(quint16 concurrency, int segments)
+{
+	CommandChain chain(concurrency);
+	for(int i = 0; i < segments; ++i) chain.add(new QProcessSegment(TRUE_EXECUTABLE));
+
+	BenchmarkResult ret;
+	ret.name = "process_throughput";
+	ret.concurrency = concurrency;
+	ret.segments = segments;
+	ret.firstStartMs = -1.0;
+
+	QElapsedTimer timer;
+	const double cpuStart = cpuMilliseconds();
+	timer.start();
+	ret.success = chain.execute();
+	ret.wallMs = timer.elapsed();
+	ret.cpuMs = cpuMilliseconds() - cpuStart;
+	return ret;
+}
+
+static BenchmarkResult runIdleChain(quint16 concurrency, int segments, long segmentTime)
+{
+	CommandChain chain(concurrency);
+	QElapsedTimer clock;
+	qint64 firstStart = -1;
+	for(int i = 0; i < segments; ++i) chain.add(new StampedTimeSegment(segmentTime, &clock, &firstStart));
+
+	BenchmarkResult ret;
+	ret.name = "idle_wait";
+	ret.concurrency = concurrency;
+	ret.segments = segments;
+
+	const double cpuStart = cpuMilliseconds();
+	clock.start();
+	ret.success = chain.execute();
+	ret.wallMs = clock.elapsed();
+	ret.cpuMs = cpuMilliseconds() - cpuStart;
+	ret.firstStartMs = firstStart < 0 ? -1.0 : firstStart / 1000000.0;
+	return ret;
+}
+
+static BenchmarkResult runLatencyChain()
+{
+	CommandChain chain(1);
+	QElapsedTimer clock;
+	qint64 firstStart = -1;
+	chain.add(new StampedTimeSegment(0, &clock, &firstStart));
+
+	BenchmarkResult ret;
+	ret.name = "schedule_latency";
+	ret.concurrency = 1;
+	ret.segments = 1;
+
+	const double cpuStart = cpuMilliseconds();
+	clock.start();
+	ret.success = chain.execute();
+	ret.wallMs = clock.elapsed();
+	ret.cpuMs = cpuMilliseconds() - cpuStart;
+	ret.firstStartMs = firstStart / 1000000.0;
+	return ret;
+}
+
+static QString toJson(const BenchmarkResult& r, int repeat)
+{
+	const double throughput = r.wallMs > 0 ? r.segments * 1000.0 / r.wallMs : 0.0;
+	return QString("{\"benchmark\":\"%1\",\"repeat\":%2,\"concurrency\":%3,\"segments\":%4,"
+		"\"wall_ms\":%5,\"cpu_ms\":%6,\"cpu_ratio\":%7,\"segments_per_sec\":%8,\"first_start_ms\":%9,\"success\":%10}")
+		.arg(r.name)
+		.arg(repeat)
+		.arg(r.concurrency)
+		.arg(r.segments)
+		.arg(r.wallMs)
+		.arg(r.cpuMs, 0, 'f', 3)
+		.arg(r.wallMs > 0 ? r.cpuMs / r.wallMs : 0.0, 0, 'f', 4)
+		.arg(throughput, 0, 'f', 2)
+		.arg(r.firstStartMs, 0, 'f', 4)
+		.arg(r.success ? "true" : "false");
+}
+
+static void usage()
+{
+	qWarning() << "Usage: command_chain_benchmark [--segments N] [--repeats N] [--output file.jsonl]";
+}
+
+/*
+ * Emits one JSON object per line (JSON Lines) to stdout or --output so that
+ * results can be diffed between scheduler revisions by a script.
+ */
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	int segments = DEFAULT_SEGMENTS;
+	int repeats = DEFAULT_REPEATS;
+	QString outputPath;
+
+	const QStringList args = QCoreApplication::arguments();
+	for(int i = 1; i < args.size(); ++i) {
+		if(args[i] == "--segments" && i + 1 < args.size()) segments = args[++i].toInt();
+		else if(args[i] == "--repeats" && i + 1 < args.size()) repeats = args[++i].toInt();
+		else if(args[i] == "--output" && i + 1 < args.size()) outputPath = args[++i];
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if(segments <= 0 || repeats <= 0) {
+		usage();
+		return 1;
+	}
+
+	QFile outFile;
+	if(outputPath.isEmpty()) outFile.open(stdout, QIODevice::WriteOnly);
+	else {
+		outFile.setFileName(outputPath);
+		if(!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			qWarning() << "Unable to open" << outputPath << "for writing";
+			return 1;
+		}
+	}
+	QTextStream out(&outFile);
+
+	QList<quint16> concurrencies;
+	concurrencies << 1 << 2 << 4 << 8;
+	const int ideal = QThread::idealThreadCount();
+	if(ideal > 0 && !concurrencies.contains(ideal)) concurrencies << ideal;
+
+	bool success = true;
+	for(int repeat = 0; repeat < repeats; ++repeat) {
+		BenchmarkResult latency = runLatencyChain();
+		success &= latency.success;
+		out << toJson(latency, repeat) << "\n";
+
+		foreach(const quint16& concurrency, concurrencies) {
+			BenchmarkResult process = runProcessChain(concurrency, segments);
+			success &= process.success;
+			out << toJson(process, repeat) << "\n";
+
+			// A handful of segments that sleep for a while: cpu_ratio shows how
+			// much the scheduler burns while it has nothing to do.
+			BenchmarkResult idle = runIdleChain(concurrency, concurrency * 2, 250);
+			success &= idle.success;
+			out << toJson(idle, repeat) << "\n";
+			out.flush();
+		}
+	}
+
+	if(!success) qWarning() << "One or more benchmark chains failed to execute";
+	return success ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#include "DistributedCompile.h"
+
+#include <QCoreApplication>
+#include <QSemaphore>
+#include <QStringList>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+#define GCC_EXECUTABLE "gcc"
+#define SOURCE_COUNT 12
+
+// Stands in for a lab machine: a daemon with its own event loop on localhost
+class DaemonThread : public QThread
+{
+public:
+	DaemonThread() : m_port(0), m_completed(0) {}
+
+	quint16 startDaemon()
+	{
+		start();
+		m_ready.acquire();
+		return m_port;
+	}
+
+	quint32 stopDaemon()
+	{
+		quit();
+		wait();
+		return m_completed;
+	}
+
+protected:
+	virtual void run()
+	{
+		CompileDaemon daemon(GCC_EXECUTABLE, 2);
+		if(daemon.listen(QHostAddress::LocalHost, 0)) m_port = daemon.port();
+		m_ready.release();
+		if(m_port) exec();
+		m_completed = daemon.completed();
+	}
+
+private:
+	QSemaphore m_ready;
+	quint16 m_port;
+	quint32 m_completed;
+};
+
+static QStringList writeSources(const QDir& dir, bool withError)
+{
+	QStringList ret;
+	for(int i = 0; i < SOURCE_COUNT; ++i) {
+		const QString path = dir.absoluteFilePath(QString("unit%1.c").arg(i));
+		QFile f(path);
+		f.open(QIODevice::WriteOnly | QIODevice::Truncate);
+		f.write("#include <stdio.h>\n#include \"shared.h\"\n");
+		f.write(QString("int unit%1(void) { return SHARED + %1; }\n").arg(i).toUtf8());
+		if(withError && i == 0) f.write("int broken(void) { return undeclared; }\n");
+		ret << path;
+	}
+	QFile header(dir.absoluteFilePath("shared.h"));
+	header.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	header.write("#define SHARED 42\n");
+	return ret;
+}
+
+static bool compileAll(CompileHostPool* pool, const Toolchain& toolchain, const QDir& dir, const QStringList& sources,
+	int* remote, QByteArray* err)
+{
+	CommandChain chain(pool->totalSlots());
+	QList<DistributedSegment*> segments;
+	foreach(const QString& source, sources) {
+		QStringList args;
+		args << "-O2" << "-Wall" << "-I" + dir.path() << "-c" << source << "-o" << QFileInfo(source).baseName() + ".o";
+		QDir().remove(dir.absoluteFilePath(QFileInfo(source).baseName() + ".o"));
+
+		QProcessSegment* local = new QProcessSegment(GCC_EXECUTABLE, args);
+		local->process()->setWorkingDirectory(dir.path());
+		DistributedSegment* segment = new DistributedSegment(pool, local, toolchain, dir.path(), args);
+		segments << segment;
+		chain.add(segment);
+	}
+	const bool success = chain.execute();
+
+	*remote = 0;
+	foreach(DistributedSegment* segment, segments) *remote += segment->remote() ? 1 : 0;
+	chain.chainSession()->err()->seek(0);
+	*err = chain.chainSession()->err()->readAll();
+
+	foreach(const QString& source, sources) {
+		if(success && !QFile::exists(dir.absoluteFilePath(QFileInfo(source).baseName() + ".o"))) {
+			qCritical() << "Missing object for" << source;
+			return false;
+		}
+	}
+	return success;
+}
+
+/*
+ * Two daemons on localhost stand in for remote machines. Checks that work is
+ * spread over both, that errors found remotely come back, and that jobs
+ * for another toolchain or meant for a daemon that has gone away are
+ * compiled locally instead.
+ */
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QDir dir = QDir::temp();
+	const QString name = QString("kiss-distributed-test-%1").arg(QCoreApplication::applicationPid());
+	dir.mkpath(name);
+	dir.cd(name);
+
+	DaemonThread first;
+	DaemonThread second;
+	const quint16 firstPort = first.startDaemon();
+	const quint16 secondPort = second.startDaemon();
+	if(!firstPort || !secondPort) {
+		qCritical() << "Unable to start compile daemons";
+		return 1;
+	}
+	const QStringList hosts = CompileHostPool::parseHosts(QString("127.0.0.1:%1, 127.0.0.1:%2").arg(firstPort).arg(secondPort));
+
+	const Toolchain gcc = ToolchainRegistry::identify(GCC_EXECUTABLE);
+	int failures = 0;
+	int remote = 0;
+	QByteArray err;
+
+	// -w alone turns warnings off, -wrapper runs a program of the client's choosing
+	if(!DistributedProtocol::isRemoteArgument("-w") || DistributedProtocol::isRemoteArgument("-wrapper")) {
+		qCritical() << "Expected -w to be sent to daemons and -wrapper to be refused";
+		++failures;
+	}
+
+	// Spread across both daemons
+	CompileHostPool pool(hosts, 1);
+	pool.refresh();
+	if(pool.totalSlots() != 5) {
+		qCritical() << "Expected both daemons to be up, got" << pool.totalSlots() << "slots";
+		++failures;
+	}
+	if(!compileAll(&pool, gcc, dir, writeSources(dir, false), &remote, &err) || remote == 0) {
+		qCritical() << "Distributed compile failed." << remote << "remote jobs:" << err;
+		++failures;
+	}
+
+	// Errors found by a daemon are reported like local ones
+	CompileHostPool errorPool(hosts, 1);
+	errorPool.refresh();
+	if(compileAll(&errorPool, gcc, dir, writeSources(dir, true), &remote, &err) || !err.contains("undeclared")) {
+		qCritical() << "Expected compile error to be reported, got:" << err;
+		++failures;
+	}
+
+	// Daemons refuse jobs for a compiler they don't have
+	Toolchain cross = gcc;
+	cross.machine = "kiss-test-unknown-machine";
+	CompileHostPool crossPool(hosts, 1);
+	crossPool.refresh();
+	if(!compileAll(&crossPool, cross, dir, writeSources(dir, false), &remote, &err) || remote != 0) {
+		qCritical() << "Expected jobs for another machine to be compiled locally." << remote << "remote jobs:" << err;
+		++failures;
+	}
+
+	// A daemon that disappears after the pool last saw it
+	CompileHostPool fallbackPool(hosts, 1);
+	fallbackPool.refresh();
+	const quint32 secondCompleted = second.stopDaemon();
+	if(!compileAll(&fallbackPool, gcc, dir, writeSources(dir, false), &remote, &err)) {
+		qCritical() << "Compile did not fall back to local jobs:" << err;
+		++failures;
+	}
+
+	const quint32 firstCompleted = first.stopDaemon();
+	if(!firstCompleted || !secondCompleted) {
+		qCritical() << "Expected jobs on both daemons, got" << firstCompleted << "and" << secondCompleted;
+		++failures;
+	}
+
+	foreach(const QString& file, dir.entryList(QDir::Files)) dir.remove(file);
+	QDir::temp().rmdir(name);
+
+	qDebug() << (failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
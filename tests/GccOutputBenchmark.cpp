@@ -0,0 +1,83 @@
+#include "GccOutput.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <QFile>
+#include <QDebug>
+
+#define DEFAULT_LOG_SIZE (8 * 1024 * 1024)
+#define DEFAULT_REPEATS 5
+
+// Roughly what a template-heavy C++ error dump looks like
+static QByteArray syntheticLog(int size)
+{
+	QByteArray ret;
+	ret.reserve(size + 1024);
+	for(int i = 0; ret.size() < size; ++i) {
+		const QByteArray n = QByteArray::number(i % 5000 + 1);
+		ret += "/home/student/project/src/main.c: In function 'main':\n";
+		ret += "/home/student/project/src/main.c:" + n + ":12: error: 'foo' undeclared (first use in this function)\n";
+		ret += "   int x = foo + std::vector<std::map<std::string, std::pair<int, std::list<double> > > >::size_type(3);\n";
+		ret += "           ^\n";
+		ret += "/home/student/project/src/main.c:" + n + ":12: note: each undeclared identifier is reported only once\n";
+		ret += "In file included from /home/student/project/src/main.c:1:0:\n";
+		ret += "/home/student/project/include/robot.h:" + n + ":5: warning: implicit declaration of function 'msleep'\n";
+		ret += "     msleep(100);\n";
+		ret += "     ^\n";
+	}
+	return ret;
+}
+
+static QString toJson(const QString& name, int repeat, int bytes, int diagnostics, qint64 nsecs)
+{
+	const double seconds = nsecs / 1000000000.0;
+	const double mbps = seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+	return QString("{\"benchmark\":\"%1\",\"repeat\":%2,\"bytes\":%3,\"diagnostics\":%4,\"ms\":%5,\"mb_per_sec\":%6}")
+		.arg(name)
+		.arg(repeat)
+		.arg(bytes)
+		.arg(diagnostics)
+		.arg(nsecs / 1000000.0, 0, 'f', 3)
+		.arg(mbps, 0, 'f', 2);
+}
+
+/*
+ * Emits JSON Lines with the throughput of GccOutput's parser on a synthetic
+ * multi-MB gcc log. Pass a path to benchmark a real log instead.
+ */
+int main(int argc, char* argv[])
+{
+	QByteArray log;
+	if(argc > 1) {
+		QFile f(argv[1]);
+		if(!f.open(QIODevice::ReadOnly)) {
+			qWarning() << "Unable to open" << argv[1] << "for reading";
+			return 1;
+		}
+		log = f.readAll();
+	} else log = syntheticLog(DEFAULT_LOG_SIZE);
+	
+	QFile outFile;
+	outFile.open(stdout, QIODevice::WriteOnly);
+	QTextStream out(&outFile);
+	
+	QElapsedTimer timer;
+	for(int repeat = 0; repeat < DEFAULT_REPEATS; ++repeat) {
+		timer.start();
+		const DiagnosticList diagnostics = GccOutput::parseCompilerOutput(log);
+		out << toJson("parse", repeat, log.size(), diagnostics.size(), timer.nsecsElapsed()) << "\n";
+		
+		QBuffer buffer(&log);
+		buffer.open(QIODevice::ReadOnly);
+		timer.start();
+		const CompileResult result = GccOutput::processCompilerOutput(&buffer);
+		int messages = 0;
+		foreach(const QStringList& list, result.categorizedOutput()) messages += list.size();
+		out << toJson("process_compiler_output", repeat, log.size(), messages, timer.nsecsElapsed()) << "\n";
+		out.flush();
+	}
+	
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include "Compiler.h"
+#include "Compilation.h"
+#include "TestCompilerC.h"
+#include "TestCompilerO.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+static void writeSource(const QString& path, int value)
+{
+	QFile f(path);
+	f.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	f.write(QString("int main(void) { return %1; }\n").arg(value).toUtf8());
+}
+
+//! \return Milliseconds spent linking, or -1 if the build failed
+static qint64 build(const QString& source)
+{
+	Compilation compilation(CompilerManager::ref().compilers(), source);
+	if(!compilation.start() || !compilation.results().success()) {
+		qCritical() << "Build failed:" << compilation.results().raw();
+		return -1;
+	}
+	return compilation.results().timings().value("link", -1);
+}
+
+/*
+ * Builds the same program three times. Every build compiles the source
+ * again, but only the last one, after the source changed, may relink.
+ */
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	CompilerManager::ref().addCompiler(new TestCompilerC());
+	CompilerManager::ref().addCompiler(new TestCompilerO());
+
+	const QString source = QDir::temp().absoluteFilePath(QString("link_cache_test_%1.c")
+		.arg(QCoreApplication::applicationPid()));
+	int failures = 0;
+
+	writeSource(source, 0);
+	const qint64 first = build(source);
+	if(first <= 0) {
+		qCritical() << "Expected the first build to link, took" << first << "ms";
+		++failures;
+	}
+
+	const qint64 unchanged = build(source);
+	if(unchanged != 0) {
+		qCritical() << "Expected an unchanged build to skip the link, took" << unchanged << "ms";
+		++failures;
+	}
+
+	writeSource(source, 1);
+	const qint64 changed = build(source);
+	if(changed <= 0) {
+		qCritical() << "Expected a changed object to be linked again, took" << changed << "ms";
+		++failures;
+	}
+
+	QFile::remove(source);
+
+	qDebug() << (failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}